@@ -12,6 +12,31 @@ namespace GameCore
 	}
 
 	EntityCameraComponent::EntityCameraComponent()
+	{
+		AddScrollCallback();
+	}
+
+	EntityCameraComponent::EntityCameraComponent(EntityCameraComponent&& anOther)
+		: myAspectRatio(anOther.myAspectRatio)
+		, myFov(anOther.myFov)
+		, myZNear(anOther.myZNear)
+		, myZFar(anOther.myZFar)
+		, myPosition(anOther.myPosition)
+		, myDirection(anOther.myDirection)
+		, myUp(anOther.myUp)
+		, myLeft(anOther.myLeft)
+	{
+		// The scroll callback captures the component address, so the moved component needs its own
+		AddScrollCallback();
+	}
+
+	EntityCameraComponent::~EntityCameraComponent()
+	{
+		InputModule* inputModule = InputModule::GetInstance();
+		inputModule->RemoveScrollCallback(myScrollCallbackId);
+	}
+
+	void EntityCameraComponent::AddScrollCallback()
 	{
 		InputModule* inputModule = InputModule::GetInstance();
 		myScrollCallbackId = inputModule->AddScrollCallback([this](double aX, double aY) {
@@ -24,12 +49,6 @@ namespace GameCore
 			}, WindowModule::GetInstance()->GetMainWindow());
 	}
 
-	EntityCameraComponent::~EntityCameraComponent()
-	{
-		InputModule* inputModule = InputModule::GetInstance();
-		inputModule->RemoveScrollCallback(myScrollCallbackId);
-	}
-
 	void EntityCameraComponent::Update()
 	{
 		myLeft = glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), myDirection);
@@ -0,0 +1,66 @@
+#include "GameCore_EntityCommandBuffer.h"
+
+namespace GameCore
+{
+	EntityCommandBuffer::~EntityCommandBuffer()
+	{
+		for (CommandListBase* commandList : myCommandLists)
+			delete commandList;
+	}
+
+	EntityId EntityCommandBuffer::Create()
+	{
+		Assert(myCreatedCount < ourEntityIndexMask, "Too many entities created in a command buffer!");
+		return MakeEntityId(myCreatedCount++, ourDeferredEntityGeneration);
+	}
+
+	void EntityCommandBuffer::Destroy(EntityId anId)
+	{
+		myDestroyedEntities.push_back(anId);
+	}
+
+	bool EntityCommandBuffer::IsEmpty() const
+	{
+		if (myCreatedCount > 0 || !myDestroyedEntities.empty())
+			return false;
+
+		for (const CommandListBase* commandList : myCommandLists)
+		{
+			if (commandList && !commandList->IsEmpty())
+				return false;
+		}
+		return true;
+	}
+
+	void EntityCommandBuffer::Apply(EntityWorld& aWorld)
+	{
+		std::vector<EntityId> createdEntities(myCreatedCount);
+		for (EntityId& entityId : createdEntities)
+			entityId = aWorld.Create();
+		myCreatedCount = 0;
+
+		std::vector<std::pair<uint, CommandListBase*>> commandLists;
+		for (CommandListBase* commandList : myCommandLists)
+		{
+			if (commandList && !commandList->IsEmpty())
+				commandLists.emplace_back(commandList->GetComponentId(aWorld), commandList);
+		}
+		std::sort(commandLists.begin(), commandLists.end());
+
+		for (const auto& [componentId, commandList] : commandLists)
+			commandList->Apply(aWorld, createdEntities);
+
+		for (EntityId entityId : myDestroyedEntities)
+			aWorld.Destroy(Resolve(entityId, createdEntities));
+		myDestroyedEntities.clear();
+	}
+
+	EntityId EntityCommandBuffer::Resolve(EntityId anId, const std::vector<EntityId>& someCreatedEntities)
+	{
+		if (GetEntityGeneration(anId) != ourDeferredEntityGeneration)
+			return anId;
+
+		Assert(GetEntityIndex(anId) < (uint)someCreatedEntities.size(), "Unknown placeholder entity, was it created by another command buffer?");
+		return someCreatedEntities[GetEntityIndex(anId)];
+	}
+}
@@ -1,55 +1,129 @@
 #include "GameCore_EntityModule.h"
+#include "GameCore_EntitySystem.h"
+#include "GameCore_EntityCommandBuffer.h"
 
 #include "GameCore_EntityCameraComponent.h"
+#include "GameCore_EntityHierarchyComponent.h"
+#include "GameCore_EntityTransformComponent.h"
+#include "GameCore_TimeModule.h"
 
 namespace GameCore
 {
 	DEFINE_GAMECORE_MODULE(EntityModule);
 
-	EntityId EntityModule::Create()
+	uint EntityModule::AddSystem(const std::string& aName, const ComponentMask& someReads, const ComponentMask& someWrites, std::function<void()> aFunction)
 	{
-		EntityId newEntity;
-		if (myFreeEntityIds.size() == 0)
-		{
-			newEntity = myNextEntityId++;
-		}
-		else
-		{
-			newEntity = *myFreeEntityIds.begin();
-			myFreeEntityIds.erase(newEntity);
-		}
+#if DEBUG_BUILD
+		auto checkContainer = [this](uint aComponentId) {
+			Assert(GetComponentContainer(aComponentId), "The containers of the components a system accesses must exist before it runs!");
+		};
+		someReads.ForEach(checkContainer);
+		someWrites.ForEach(checkContainer);
+#endif
+
+		EntitySystemEntry entry;
+		entry.myName = aName;
+		entry.myReads = someReads;
+		entry.myWrites = someWrites;
+		entry.myFunction = std::move(aFunction);
+		return mySystemScheduler->AddSystem(entry);
+	}
+
+	uint EntityModule::AddBucketedSystem(const std::string& aName, const ComponentMask& someReads, const ComponentMask& someWrites, uint aComponentId, const EntityUpdateRates& someRates, EntityBucketedSystemFunction aFunction)
+	{
+		ComponentMask reads = someReads;
+		reads.Set(GetComponentId<Entity3DTransformComponent>());
+		reads.Set(GetComponentId<EntityHierarchyComponent>());
+
+		std::shared_ptr<EntityUpdateRateBuckets> buckets = std::make_shared<EntityUpdateRateBuckets>(someRates);
+		return AddSystem(aName, reads, someWrites, [this, aComponentId, buckets, function = std::move(aFunction)]() {
+			const TimeModule* time = TimeModule::GetInstance();
+			const uint frame = time->GetFrameCounter();
+			const uint64 timeNs = time->GetTimeNs();
+			const float frameDeltaTime = time->GetDeltaTime();
+
+			// Only reads, through the const accessors so nothing is marked as changed
+			const EntityWorld& world = *this;
+			const ComponentContainerBase* container = GetComponentContainer(aComponentId);
+			const ComponentContainer<Entity3DTransformComponent>* transforms = world.GetComponentContainer<Entity3DTransformComponent>();
+			const ComponentContainer<EntityHierarchyComponent>* hierarchies = world.GetComponentContainer<EntityHierarchyComponent>();
+
+			// Tags have no dense array, so the entities are visited through the container
+			buckets->Clear();
+			container->ForEachEntityId([&](EntityId anEntityId) {
+				float squaredDistance = 0.0f;
+				if (const EntityHierarchyComponent* node = hierarchies->GetComponent(anEntityId))
+					squaredDistance = glm::length2(glm::vec3(node->GetWorldMatrix()[3]) - myUpdateRateOrigin);
+				else if (const Entity3DTransformComponent* transform = transforms->GetComponent(anEntityId))
+					squaredDistance = glm::length2(transform->GetPosition() - myUpdateRateOrigin);
+				buckets->Select(anEntityId, squaredDistance, frame, timeNs, frameDeltaTime);
+			});
+
+			if (!buckets->GetEntities().empty())
+				function(buckets->GetEntities(), buckets->GetDeltaTimes());
+		});
+	}
 
-		for (uint i = 0; i < (uint)myComponentContainers.size(); ++i)
-			myComponentContainers[i]->OnEntityCreated(newEntity);
+	void EntityModule::RemoveSystem(uint aSystemId)
+	{
+		mySystemScheduler->RemoveSystem(aSystemId);
+	}
 
-		return newEntity;
+	const EntityScheduleTrace& EntityModule::GetLastScheduleTrace() const
+	{
+		return mySystemScheduler->GetLastTrace();
 	}
 
-	void EntityModule::Destroy(EntityId anId)
+	EntityCommandBuffer& EntityModule::GetCommandBuffer()
 	{
-		if (anId >= myNextEntityId || myFreeEntityIds.find(anId) != myFreeEntityIds.end())
-			return;
+		const std::thread::id threadId = std::this_thread::get_id();
 
-		for (uint i = 0; i < (uint)myComponentContainers.size(); ++i)
-			myComponentContainers[i]->OnEntityDestroyed(anId);
+		std::lock_guard<std::mutex> lock(myCommandBuffersMutex);
+		for (const auto& [bufferThreadId, buffer] : myCommandBuffers)
+		{
+			if (bufferThreadId == threadId)
+				return *buffer;
+		}
 
-		myFreeEntityIds.insert(anId);
+		myCommandBuffers.emplace_back(threadId, new EntityCommandBuffer());
+		return *myCommandBuffers.back().second;
+	}
+
+	void EntityModule::FlushCommandBuffers()
+	{
+		std::lock_guard<std::mutex> lock(myCommandBuffersMutex);
+		for (const auto& [threadId, buffer] : myCommandBuffers)
+			buffer->Apply(*this);
 	}
 
 	void EntityModule::OnRegister()
 	{
+#if DEBUG_BUILD
+		myWorkerPool.SetWorkersName("Entity Worker");
+#endif
+		myWorkerPool.SetWorkersCount();
+		mySystemScheduler = new EntitySystemScheduler();
 	}
 
 	void EntityModule::OnUnregister()
 	{
-		for (ComponentContainerBase* container : myComponentContainers)
-			delete container;
-		myComponentContainers.clear();
+		SafeDelete(mySystemScheduler);
+		myWorkerPool.SetWorkersCount(0);
+
+		for (const auto& [threadId, buffer] : myCommandBuffers)
+			delete buffer;
+		myCommandBuffers.clear();
+
+		Reset();
 	}
 
 	void EntityModule::OnUpdate(UpdateType aType)
 	{
-		if (aType == Module::UpdateType::MainUpdate)
+		if (aType == Module::UpdateType::EarlyUpdate)
+		{
+			AdvanceChangeTick();
+		}
+		else if (aType == Module::UpdateType::MainUpdate)
 		{
 			ComponentContainer<EntityCameraComponent>* container = GetComponentContainer<EntityCameraComponent>();
 			for (EntityCameraComponent* component : *container)
@@ -57,6 +131,16 @@ namespace GameCore
 				component->SetAspectRatio(Facade::GetInstance()->GetMainWindowAspectRatio());
 				component->Update();
 			}
+			if (container->GetSize() > 0)
+				myUpdateRateOrigin = container->GetAt(0)->GetPosition();
+
+			SetComponentContainersLocked(true);
+			mySystemScheduler->Run(myWorkerPool);
+			SetComponentContainersLocked(false);
+			FlushCommandBuffers();
+			UpdateHierarchy();
+			NotifyObservers();
+			ShrinkUnusedMemory();
 		}
 	}
 }
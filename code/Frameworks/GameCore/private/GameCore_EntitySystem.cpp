@@ -0,0 +1,175 @@
+#include "GameCore_EntitySystem.h"
+
+namespace GameCore
+{
+	EntityUpdateRateBuckets::EntityUpdateRateBuckets(const EntityUpdateRates& someRates)
+		: myFramePeriods(someRates.myFramePeriods)
+	{
+		Assert(someRates.myFramePeriods.size() == someRates.myDistances.size() + 1, "One frame period is needed per bucket!");
+		Assert(std::is_sorted(someRates.myDistances.begin(), someRates.myDistances.end()), "Bucket distances must be increasing!");
+		for (float distance : someRates.myDistances)
+			mySquaredDistances.push_back(distance * distance);
+		for (uint& period : myFramePeriods)
+			period = (std::max)(period, 1u);
+	}
+
+	void EntityUpdateRateBuckets::Clear()
+	{
+		myEntities.clear();
+		myDeltaTimes.clear();
+	}
+
+	void EntityUpdateRateBuckets::Select(EntityId anId, float aSquaredDistance, uint aFrame, uint64 aTimeNs, float aFrameDeltaTime)
+	{
+		const uint bucket = (uint)(std::upper_bound(mySquaredDistances.begin(), mySquaredDistances.end(), aSquaredDistance) - mySquaredDistances.begin());
+		const uint entityIndex = GetEntityIndex(anId);
+		if ((entityIndex + aFrame) % myFramePeriods[bucket] != 0)
+			return;
+
+		if (entityIndex >= (uint)myLastUpdates.size())
+			myLastUpdates.resize(entityIndex + 1);
+
+		LastUpdate& lastUpdate = myLastUpdates[entityIndex];
+		const float deltaTime = lastUpdate.myEntityId == anId ? (float)(aTimeNs - lastUpdate.myTimeNs) * 1e-9f : aFrameDeltaTime;
+		lastUpdate.myEntityId = anId;
+		lastUpdate.myTimeNs = aTimeNs;
+
+		myEntities.push_back(anId);
+		myDeltaTimes.push_back(deltaTime);
+	}
+
+	void EntityScheduleTrace::Print(std::ostream& aStream) const
+	{
+		aStream << "Entity systems schedule: " << myDurationNs / 1000 << "us" << std::endl;
+		for (const System& system : mySystems)
+		{
+			aStream << (system.myIsOnCriticalPath ? " * " : "   ") << system.myName
+				<< " [" << system.myStartNs / 1000 << "us - " << system.myEndNs / 1000 << "us]"
+				<< " thread " << system.myThread << std::endl;
+		}
+
+		aStream << "Critical path:";
+		for (uint index : myCriticalPath)
+			aStream << " " << mySystems[index].myName;
+		aStream << std::endl;
+	}
+
+	uint EntitySystemScheduler::AddSystem(const EntitySystemEntry& aSystem)
+	{
+		myGraphIsDirty = true;
+		EntitySystemEntry system = aSystem;
+		system.myRegistrationIndex = myNextRegistrationIndex++;
+		return mySystems.Add(system);
+	}
+
+	void EntitySystemScheduler::RemoveSystem(uint aSystemId)
+	{
+		myGraphIsDirty = true;
+		mySystems.Remove(aSystemId);
+	}
+
+	void EntitySystemScheduler::Run(Thread::WorkerPool& aPool)
+	{
+		if (myGraphIsDirty)
+			RebuildGraph();
+
+		const uint systemsCount = (uint)myOrder.size();
+		myTrace.mySystems.resize(systemsCount);
+		myTrace.myCriticalPath.clear();
+		myTrace.myDurationNs = 0;
+		if (systemsCount == 0)
+			return;
+
+		const auto startTime = std::chrono::high_resolution_clock::now();
+		auto getTimeNs = [startTime]() {
+			return (uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - startTime).count();
+		};
+
+		// The whole graph is submitted at once, each system is queued by the pool once the systems it depends on are done
+		// myOrder is a topological order, so the dependencies are always requested first
+		// The frame waits for them, so they go ahead of the streaming and other background jobs
+		std::vector<Thread::JobHandle> jobs(systemsCount);
+		std::vector<Thread::JobHandle> dependencies;
+		for (uint index = 0; index < systemsCount; ++index)
+		{
+			dependencies.clear();
+			for (uint dependency : myDependencies[index])
+				dependencies.push_back(jobs[dependency]);
+
+			jobs[index] = aPool.RequestJob([this, &getTimeNs, index]() {
+				EntityScheduleTrace::System& trace = myTrace.mySystems[index];
+				trace.myStartNs = getTimeNs();
+				mySystems.myEntries[myOrder[index]].myFunction();
+				trace.myEndNs = getTimeNs();
+				trace.myThread = std::this_thread::get_id();
+			}, dependencies, Thread::JobPriority::FrameCritical);
+		}
+
+		for (const Thread::JobHandle& job : jobs)
+			aPool.WaitForJob(job);
+
+		myTrace.myDurationNs = getTimeNs();
+		ComputeCriticalPath();
+	}
+
+	void EntitySystemScheduler::RebuildGraph()
+	{
+		myOrder.clear();
+		for (uint i = 0; i < (uint)mySystems.myEntries.size(); ++i)
+		{
+			if (mySystems.myEntries[i].IsSet())
+				myOrder.push_back(i);
+		}
+		std::sort(myOrder.begin(), myOrder.end(), [this](uint aLeft, uint aRight) {
+			return mySystems.myEntries[aLeft].myRegistrationIndex < mySystems.myEntries[aRight].myRegistrationIndex;
+		});
+
+		const uint systemsCount = (uint)myOrder.size();
+		myDependencies.assign(systemsCount, {});
+		for (uint i = 0; i < systemsCount; ++i)
+		{
+			const EntitySystemEntry& system = mySystems.myEntries[myOrder[i]];
+			for (uint j = 0; j < i; ++j)
+			{
+				if (system.ConflictsWith(mySystems.myEntries[myOrder[j]]))
+					myDependencies[i].push_back(j);
+			}
+		}
+
+		myTrace.mySystems.resize(systemsCount);
+		for (uint i = 0; i < systemsCount; ++i)
+			myTrace.mySystems[i].myName = mySystems.myEntries[myOrder[i]].myName;
+
+		myGraphIsDirty = false;
+	}
+
+	void EntitySystemScheduler::ComputeCriticalPath()
+	{
+		std::vector<EntityScheduleTrace::System>& systems = myTrace.mySystems;
+
+		// Start from the system that finished last, and walk back through the dependency that finished last each time
+		uint current = 0;
+		for (uint i = 0; i < (uint)systems.size(); ++i)
+		{
+			systems[i].myIsOnCriticalPath = false;
+			if (systems[i].myEndNs > systems[current].myEndNs)
+				current = i;
+		}
+
+		while (current != UINT_MAX)
+		{
+			systems[current].myIsOnCriticalPath = true;
+			myTrace.myCriticalPath.push_back(current);
+
+			uint previous = UINT_MAX;
+			for (uint dependency : myDependencies[current])
+			{
+				if (previous == UINT_MAX || systems[dependency].myEndNs > systems[previous].myEndNs)
+					previous = dependency;
+			}
+			current = previous;
+		}
+
+		std::reverse(myTrace.myCriticalPath.begin(), myTrace.myCriticalPath.end());
+	}
+}
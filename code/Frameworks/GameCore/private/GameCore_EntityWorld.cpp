@@ -0,0 +1,511 @@
+#include "GameCore_EntityModule.h"
+
+#include "GameCore_EntityHierarchyComponent.h"
+#include "GameCore_EntityTransformComponent.h"
+
+namespace GameCore
+{
+	EntityWorld::~EntityWorld()
+	{
+		Reset();
+	}
+
+	void EntityWorld::Reset()
+	{
+		myObservers.myEntries.clear();
+
+		for (EntityCachedViewBase* view : myCachedViews)
+			delete view;
+		myCachedViews.clear();
+
+		for (ComponentContainerBase* container : myComponentContainers)
+			delete container;
+		myComponentContainers.clear();
+
+		myEntities.clear();
+		myEntityMasks.clear();
+		myFreeHead = ourEntityIndexMask;
+		myFreeTail = ourEntityIndexMask;
+		myFreeCount = 0;
+	}
+
+	EntityId EntityWorld::Create()
+	{
+		EntityId newEntity;
+		if (myFreeCount == 0)
+		{
+			const uint index = (uint)myEntities.size();
+			Assert(index < ourEntityIndexMask, "Too many entities!");
+			newEntity = MakeEntityId(index, 0);
+			myEntities.push_back(newEntity);
+			myEntityMasks.emplace_back();
+		}
+		else
+		{
+			const uint index = myFreeHead;
+			myFreeHead = GetEntityIndex(myEntities[index]);
+			myFreeCount--;
+			newEntity = MakeEntityId(index, GetEntityGeneration(myEntities[index]));
+			myEntities[index] = newEntity;
+		}
+
+		return newEntity;
+	}
+
+	void EntityWorld::CreateMany(std::span<EntityId> someOutIds)
+	{
+		const uint count = (uint)someOutIds.size();
+		const uint reusedCount = std::min(count, myFreeCount);
+		for (uint i = 0; i < reusedCount; ++i)
+		{
+			const uint index = myFreeHead;
+			myFreeHead = GetEntityIndex(myEntities[index]);
+			someOutIds[i] = MakeEntityId(index, GetEntityGeneration(myEntities[index]));
+			myEntities[index] = someOutIds[i];
+		}
+		myFreeCount -= reusedCount;
+
+		const uint firstIndex = (uint)myEntities.size();
+		Assert(firstIndex + (count - reusedCount) <= ourEntityIndexMask, "Too many entities!");
+		myEntities.reserve(firstIndex + (count - reusedCount));
+		for (uint i = reusedCount; i < count; ++i)
+		{
+			someOutIds[i] = MakeEntityId((uint)myEntities.size(), 0);
+			myEntities.push_back(someOutIds[i]);
+		}
+		myEntityMasks.resize(myEntities.size());
+	}
+
+	void EntityWorld::Destroy(EntityId anId)
+	{
+		if (!Exists(anId))
+			return;
+
+		if (HasComponent<EntityHierarchyComponent>(anId))
+			DetachFromHierarchy(anId);
+
+		// Removing the components clears their bits, so iterate on a copy
+		const uint index = GetEntityIndex(anId);
+		const ComponentMask mask = myEntityMasks[index];
+		mask.ForEach([this, anId](uint aComponentId) {
+			myComponentContainers[aComponentId]->OnEntityDestroyed(anId);
+		});
+
+		// Append the slot to the free list, the next id using it will have the next generation
+		uint nextGeneration = (GetEntityGeneration(anId) + 1) & ourEntityGenerationMask;
+		if (nextGeneration == ourDeferredEntityGeneration)
+			nextGeneration = 0;
+		myEntities[index] = MakeEntityId(ourEntityIndexMask, nextGeneration);
+		if (myFreeCount == 0)
+			myFreeHead = index;
+		else
+			myEntities[myFreeTail] = MakeEntityId(index, GetEntityGeneration(myEntities[myFreeTail]));
+		myFreeTail = index;
+		myFreeCount++;
+	}
+
+	EntityRemap EntityWorld::Merge(EntityWorld& aSource)
+	{
+		Assert(&aSource != this, "Merging a world into itself!");
+
+		// Alive slots hold their own id, free slots hold the index of the next free slot
+		EntityRemap remap;
+		remap.mySourceIds = aSource.myEntities;
+		remap.myDestinationIds.assign(aSource.myEntities.size(), UINT_MAX);
+		std::vector<uint> aliveIndices;
+		aliveIndices.reserve(aSource.myEntities.size() - aSource.myFreeCount);
+		for (uint i = 0; i < (uint)aSource.myEntities.size(); ++i)
+		{
+			if (GetEntityIndex(aSource.myEntities[i]) == i)
+				aliveIndices.push_back(i);
+		}
+
+		std::vector<EntityId> newIds(aliveIndices.size());
+		CreateMany(newIds);
+		for (uint i = 0; i < (uint)aliveIndices.size(); ++i)
+			remap.myDestinationIds[aliveIndices[i]] = newIds[i];
+
+		for (uint componentId = 0; componentId < (uint)aSource.myComponentContainers.size(); ++componentId)
+		{
+			ComponentContainerBase* sourceContainer = aSource.myComponentContainers[componentId];
+			if (!sourceContainer || sourceContainer->GetSize() == 0)
+				continue;
+
+			if (componentId >= (uint)myComponentContainers.size() || !myComponentContainers[componentId])
+				AddComponentContainer(componentId, sourceContainer->CreateEmpty());
+			sourceContainer->MoveComponentsTo(*myComponentContainers[componentId], remap);
+		}
+
+		// The components are gone, freeing the slots makes sure the ids of aSource are never valid there again
+		for (uint index : aliveIndices)
+			aSource.Destroy(aSource.myEntities[index]);
+
+		return remap;
+	}
+
+	void EntityWorld::AdvanceChangeTick()
+	{
+		myChangeTick++;
+		for (ComponentContainerBase* container : myComponentContainers)
+		{
+			if (container)
+				container->SetChangeTick(myChangeTick);
+		}
+	}
+
+	void EntityWorld::SetParent(EntityId aChild, EntityId aParent)
+	{
+		Assert(Exists(aChild), "Setting the parent of an entity that doesn't exist!");
+		ComponentContainer<EntityHierarchyComponent>* hierarchies = GetComponentContainer<EntityHierarchyComponent>();
+
+		// Adding components doesn't move the existing ones, so the pointers stay valid
+		EntityHierarchyComponent* node = hierarchies->AddComponent(aChild);
+		EntityHierarchyComponent* parentNode = nullptr;
+		if (aParent != UINT_MAX)
+		{
+			Assert(Exists(aParent), "Setting a parent that doesn't exist!");
+			parentNode = hierarchies->AddComponent(aParent);
+			for (EntityId ancestor = aParent; ancestor != UINT_MAX; ancestor = hierarchies->GetComponentUntracked(ancestor)->myParent)
+				Assert(ancestor != aChild, "Setting a parent would create a cycle in the hierarchy!");
+		}
+
+		if (node->myParent == aParent)
+			return;
+
+		if (node->myParent != UINT_MAX)
+		{
+			EntityHierarchyComponent* oldParentNode = hierarchies->GetComponentUntracked(node->myParent);
+			if (node->myPreviousSibling != UINT_MAX)
+				hierarchies->GetComponentUntracked(node->myPreviousSibling)->myNextSibling = node->myNextSibling;
+			else
+				oldParentNode->myFirstChild = node->myNextSibling;
+			if (node->myNextSibling != UINT_MAX)
+				hierarchies->GetComponentUntracked(node->myNextSibling)->myPreviousSibling = node->myPreviousSibling;
+		}
+
+		node->myParent = aParent;
+		node->myPreviousSibling = UINT_MAX;
+		node->myNextSibling = UINT_MAX;
+		if (parentNode)
+		{
+			node->myNextSibling = parentNode->myFirstChild;
+			if (parentNode->myFirstChild != UINT_MAX)
+				hierarchies->GetComponentUntracked(parentNode->myFirstChild)->myPreviousSibling = aChild;
+			parentNode->myFirstChild = aChild;
+		}
+
+		UpdateHierarchyDepths(aChild, parentNode ? parentNode->myDepth + 1 : 0);
+		node->myIsDirty = true;
+	}
+
+	glm::mat4 EntityWorld::GetWorldMatrix(EntityId anId) const
+	{
+		if (const EntityHierarchyComponent* node = GetComponent<EntityHierarchyComponent>(anId))
+			return node->myWorldMatrix;
+		if (const Entity3DTransformComponent* transform = GetComponent<Entity3DTransformComponent>(anId))
+			return transform->GetMatrix();
+		return glm::mat4(1.0f);
+	}
+
+	void EntityWorld::DetachFromHierarchy(EntityId anId)
+	{
+		// The children become roots
+		ComponentContainer<EntityHierarchyComponent>* hierarchies = GetComponentContainer<EntityHierarchyComponent>();
+		while (hierarchies->GetComponentUntracked(anId)->myFirstChild != UINT_MAX)
+			SetParent(hierarchies->GetComponentUntracked(anId)->myFirstChild, UINT_MAX);
+		SetParent(anId, UINT_MAX);
+	}
+
+	void EntityWorld::UpdateHierarchyDepths(EntityId aRoot, uint aDepth)
+	{
+		ComponentContainer<EntityHierarchyComponent>* hierarchies = GetComponentContainer<EntityHierarchyComponent>();
+		std::vector<std::pair<EntityId, uint>> stack = { { aRoot, aDepth } };
+		while (!stack.empty())
+		{
+			const auto [entityId, depth] = stack.back();
+			stack.pop_back();
+
+			EntityHierarchyComponent* node = hierarchies->GetComponentUntracked(entityId);
+			node->myDepth = depth;
+			for (EntityId child = node->myFirstChild; child != UINT_MAX; child = hierarchies->GetComponentUntracked(child)->myNextSibling)
+				stack.emplace_back(child, depth + 1);
+		}
+	}
+
+	void EntityWorld::UpdateHierarchy()
+	{
+		ComponentContainer<EntityHierarchyComponent>* hierarchies = GetComponentContainer<EntityHierarchyComponent>();
+		ComponentContainer<Entity3DTransformComponent>* transforms = GetComponentContainer<Entity3DTransformComponent>();
+
+		// Nodes that were added or moved are already dirty, nodes whose transform changed become dirty
+		std::vector<std::pair<uint, EntityId>> dirtyNodes;
+		hierarchies->ForEachChangedSince(myHierarchyUpdateTick, [&dirtyNodes](EntityId anId, EntityHierarchyComponent* aNode) {
+			if (aNode->myIsDirty)
+				dirtyNodes.emplace_back(aNode->myDepth, anId);
+		});
+		transforms->ForEachChangedSince(myHierarchyUpdateTick, [hierarchies, &dirtyNodes](EntityId anId, Entity3DTransformComponent*) {
+			EntityHierarchyComponent* node = hierarchies->GetComponentUntracked(anId);
+			if (node && !node->myIsDirty)
+			{
+				node->myIsDirty = true;
+				dirtyNodes.emplace_back(node->myDepth, anId);
+			}
+		});
+		// Inclusive: transforms changed later during this tick are picked up by the next update, at the cost of recomputing the ones seen now
+		myHierarchyUpdateTick = myChangeTick;
+
+		// Shallowest nodes first: a dirty node below another one is recomputed with the subtree of its ancestor, and then skipped
+		std::sort(dirtyNodes.begin(), dirtyNodes.end());
+		std::vector<EntityId> stack;
+		for (const auto& [depth, dirtyId] : dirtyNodes)
+		{
+			if (!hierarchies->GetComponentUntracked(dirtyId)->myIsDirty)
+				continue;
+
+			stack.push_back(dirtyId);
+			while (!stack.empty())
+			{
+				const EntityId entityId = stack.back();
+				stack.pop_back();
+
+				EntityHierarchyComponent* node = hierarchies->GetComponentUntracked(entityId);
+				const Entity3DTransformComponent* transform = transforms->GetComponentUntracked(entityId);
+				const glm::mat4 localMatrix = transform ? transform->GetMatrix() : glm::mat4(1.0f);
+				if (node->myParent != UINT_MAX)
+					node->myWorldMatrix = hierarchies->GetComponentUntracked(node->myParent)->myWorldMatrix * localMatrix;
+				else
+					node->myWorldMatrix = localMatrix;
+				node->myIsDirty = false;
+				hierarchies->MarkChanged(entityId);
+
+				for (EntityId child = node->myFirstChild; child != UINT_MAX; child = hierarchies->GetComponentUntracked(child)->myNextSibling)
+					stack.push_back(child);
+			}
+		}
+	}
+
+	void EntityWorld::SaveSnapshot(std::vector<char>& someOutData) const
+	{
+		EntitySnapshotWriter writer(someOutData);
+		writer.Write(ourEntitySnapshotMagic);
+		writer.Write(ourEntitySnapshotVersion);
+		writer.Write(myChangeTick);
+
+		writer.Write((uint)myEntities.size());
+		writer.WriteBytes(myEntities.data(), myEntities.size() * sizeof(EntityId));
+		writer.Write(myFreeHead);
+		writer.Write(myFreeTail);
+		writer.Write(myFreeCount);
+
+		// Restoring clears all the containers, so the empty ones are left out: they would only make the snapshot depend on the types the world happened to use
+		auto isSaved = [](const ComponentContainerBase* aContainer) {
+			return aContainer && aContainer->CanSnapshot() && aContainer->GetSize() > 0;
+		};
+
+		uint containersCount = 0;
+		for (const ComponentContainerBase* container : myComponentContainers)
+			containersCount += isSaved(container) ? 1 : 0;
+		writer.Write(containersCount);
+
+		// Each container is prefixed by the size of its data, so unknown containers can be skipped
+		for (const ComponentContainerBase* container : myComponentContainers)
+		{
+			if (!isSaved(container))
+				continue;
+
+			writer.Write(std::string(container->GetTypeName()));
+			const size_t sizeOffset = writer.GetOffset();
+			writer.Write((uint64)0);
+			container->WriteSnapshot(writer);
+			const uint64 size = (uint64)(writer.GetOffset() - sizeOffset - sizeof(uint64));
+			std::memcpy(writer.GetData(sizeOffset), &size, sizeof(uint64));
+		}
+	}
+
+	bool EntityWorld::RestoreSnapshot(const char* someData, size_t aSize)
+	{
+		EntitySnapshotReader reader(someData, aSize);
+		if (reader.Read<uint>() != ourEntitySnapshotMagic || reader.Read<uint>() != ourEntitySnapshotVersion)
+			return false;
+
+		const uint changeTick = reader.Read<uint>();
+		const uint entitiesCount = reader.Read<uint>();
+		if (entitiesCount > ourEntityIndexMask || (size_t)entitiesCount * sizeof(EntityId) > reader.GetRemainingSize())
+			return false;
+
+		for (ComponentContainerBase* container : myComponentContainers)
+		{
+			if (container)
+				container->Clear();
+		}
+
+		myEntities.resize(entitiesCount);
+		reader.ReadBytes(myEntities.data(), entitiesCount * sizeof(EntityId));
+		myFreeHead = reader.Read<uint>();
+		myFreeTail = reader.Read<uint>();
+		myFreeCount = reader.Read<uint>();
+		myEntityMasks.assign(entitiesCount, ComponentMask());
+
+		// Create and Destroy follow the free list blindly, so it must go from the head to the tail through distinct free slots
+		// Alive slots hold their own index
+		bool isFreeListValid = myFreeCount <= entitiesCount;
+		std::vector<bool> visitedSlots(isFreeListValid ? entitiesCount : 0, false);
+		uint freeIndex = myFreeHead;
+		for (uint i = 0; i < myFreeCount && isFreeListValid; ++i)
+		{
+			isFreeListValid = freeIndex < entitiesCount && !visitedSlots[freeIndex] && GetEntityIndex(myEntities[freeIndex]) != freeIndex && (i + 1 < myFreeCount || freeIndex == myFreeTail);
+			if (isFreeListValid)
+			{
+				visitedSlots[freeIndex] = true;
+				freeIndex = GetEntityIndex(myEntities[freeIndex]);
+			}
+		}
+		if (!isFreeListValid || reader.HasFailed())
+		{
+			myEntities.clear();
+			myEntityMasks.clear();
+			myFreeHead = ourEntityIndexMask;
+			myFreeTail = ourEntityIndexMask;
+			myFreeCount = 0;
+			return false;
+		}
+
+		myChangeTick = changeTick;
+		myHierarchyUpdateTick = changeTick;
+		for (ComponentContainerBase* container : myComponentContainers)
+		{
+			if (container)
+				container->SetChangeTick(myChangeTick);
+		}
+
+		bool isComplete = true;
+		const uint containersCount = reader.Read<uint>();
+		for (uint i = 0; i < containersCount && !reader.HasFailed(); ++i)
+		{
+			const std::string typeName = reader.ReadString();
+			EntitySnapshotReader containerReader = reader.ReadSubReader((size_t)reader.Read<uint64>());
+
+			auto it = std::find_if(myComponentContainers.begin(), myComponentContainers.end(), [&typeName](const ComponentContainerBase* aContainer) {
+				return aContainer && typeName == aContainer->GetTypeName();
+			});
+			if (it == myComponentContainers.end())
+			{
+				isComplete = false;
+				continue;
+			}
+
+			(*it)->ReadSnapshot(containerReader);
+			isComplete &= !containerReader.HasFailed();
+		}
+
+		return isComplete && !reader.HasFailed();
+	}
+
+	uint EntityWorld::AddObserver(uint aComponentId, ComponentEvent anEvent, ComponentObserverFunction aFunction)
+	{
+		ComponentObserverEntry entry;
+		entry.myComponentId = aComponentId;
+		entry.myEvent = anEvent;
+		entry.myFunction = std::move(aFunction);
+		const uint observerId = myObservers.Add(entry);
+		UpdateObservedEvents(aComponentId);
+		return observerId;
+	}
+
+	void EntityWorld::RemoveObserver(uint anObserverId)
+	{
+		const uint componentId = myObservers.myEntries[anObserverId].myComponentId;
+		myObservers.Remove(anObserverId);
+		UpdateObservedEvents(componentId);
+	}
+
+	void EntityWorld::AddComponentContainer(uint aComponentId, ComponentContainerBase* aContainer)
+	{
+		Assert(aComponentId < ourMaxComponentTypes, "Too many component types, increase ourMaxComponentTypes!");
+		Assert(!myComponentContainersAreLocked, "Component containers can't be created while the systems run, declare the component in Reads or Writes!");
+		if (aComponentId >= (uint)myComponentContainers.size())
+			myComponentContainers.resize(aComponentId + 1, nullptr);
+
+		aContainer->BindEntities(&myEntities, &myEntityMasks, aComponentId);
+		aContainer->SetChangeTick(myChangeTick);
+		myComponentContainers[aComponentId] = aContainer;
+		UpdateObservedEvents(aComponentId);
+	}
+
+	void EntityWorld::UpdateObservedEvents(uint aComponentId)
+	{
+		// Containers created later are updated by AddComponentContainer
+		if (aComponentId >= (uint)myComponentContainers.size() || !myComponentContainers[aComponentId])
+			return;
+
+		for (uint event = 0; event < (uint)ComponentEvent::Count; ++event)
+		{
+			const bool isObserved = std::any_of(myObservers.myEntries.begin(), myObservers.myEntries.end(), [aComponentId, event](const ComponentObserverEntry& anEntry) {
+				return anEntry.IsSet() && anEntry.myComponentId == aComponentId && (uint)anEntry.myEvent == event;
+			});
+			myComponentContainers[aComponentId]->SetObservedEvent((ComponentEvent)event, isObserved);
+		}
+	}
+
+	void EntityWorld::NotifyObservers()
+	{
+		constexpr ComponentEvent events[] = { ComponentEvent::Remove, ComponentEvent::Add, ComponentEvent::Replace };
+
+		std::vector<EntityId> entityIds;
+		for (uint componentId = 0; componentId < (uint)myComponentContainers.size(); ++componentId)
+		{
+			if (!myComponentContainers[componentId])
+				continue;
+
+			for (ComponentEvent event : events)
+			{
+				myComponentContainers[componentId]->TakeEvents(event, entityIds);
+				if (entityIds.empty())
+					continue;
+
+				std::sort(entityIds.begin(), entityIds.end());
+				entityIds.erase(std::unique(entityIds.begin(), entityIds.end()), entityIds.end());
+
+				// Only report the changes that still hold
+				const bool shouldHaveComponent = event != ComponentEvent::Remove;
+				std::erase_if(entityIds, [this, componentId, shouldHaveComponent](EntityId anId) {
+					return (Exists(anId) && myEntityMasks[GetEntityIndex(anId)].Test(componentId)) != shouldHaveComponent;
+				});
+				if (entityIds.empty())
+					continue;
+
+				// Observers may add other observers, so the entries may move while calling them
+				for (uint i = 0; i < (uint)myObservers.myEntries.size(); ++i)
+				{
+					const ComponentObserverEntry& entry = myObservers.myEntries[i];
+					if (entry.IsSet() && entry.myComponentId == componentId && entry.myEvent == event)
+					{
+						const ComponentObserverFunction function = entry.myFunction;
+						function(entityIds);
+					}
+				}
+			}
+		}
+	}
+
+	void EntityWorld::ShrinkToFit()
+	{
+		for (ComponentContainerBase* container : myComponentContainers)
+		{
+			if (container)
+				container->ShrinkToFit();
+		}
+	}
+
+	void EntityWorld::ShrinkUnusedMemory()
+	{
+		if (myAutoShrinkThreshold == 0)
+			return;
+
+		for (ComponentContainerBase* container : myComponentContainers)
+		{
+			if (container && container->HasUnusedChunks(myAutoShrinkThreshold))
+				container->ShrinkToFit();
+		}
+	}
+}
@@ -3,33 +3,283 @@
 #if WINDOWS_BUILD
 #include <windows.h>
 #elif LINUX_BUILD
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <fstream>
 #endif
 
+#include <algorithm>
+#include <cstdio>
+
 namespace Thread
 {
-	void JobData::Wait()
+	namespace
 	{
-		// Avoid locking the mutex if we know we are done
-		if (myDone)
-			return;
+#if LINUX_BUILD
+		const std::string locCpusPath = "/sys/devices/system/cpu/";
+
+		// Nice values of WorkerPriority, going below 0 needs CAP_SYS_NICE or a raised RLIMIT_NICE, otherwise the default is kept
+		constexpr int locHighPriorityNice = -5;
+		constexpr int locLowPriorityNice = 5;
+
+		// Parses the CPU lists of sysfs, ie: "0-3,8,10-11"
+		bool ReadCpuList(const std::string& aPath, std::vector<uint>& anOutCpus)
+		{
+			std::ifstream file(aPath);
+			std::string list;
+			if (!std::getline(file, list))
+				return false;
+
+			anOutCpus.clear();
+			size_t begin = 0;
+			while (begin < list.size())
+			{
+				size_t end = list.find(',', begin);
+				if (end == std::string::npos)
+					end = list.size();
+
+				uint first = 0;
+				uint last = 0;
+				const int readCount = std::sscanf(list.substr(begin, end - begin).c_str(), "%u-%u", &first, &last);
+				if (readCount < 1)
+					return false;
+				if (readCount == 1)
+					last = first;
+				for (uint cpu = first; cpu <= last; ++cpu)
+					anOutCpus.push_back(cpu);
+
+				begin = end + 1;
+			}
+			return !anOutCpus.empty();
+		}
+
+		// First CPU sharing the last level cache of aCpuPath, the index of the highest level differs between CPUs
+		uint ReadLastCacheFirstCpu(const std::string& aCpuPath, uint aDefaultCpu)
+		{
+			uint firstCpu = aDefaultCpu;
+			uint lastLevel = 0;
+			std::vector<uint> sharedCpus;
+			for (uint index = 0;; ++index)
+			{
+				const std::string cachePath = aCpuPath + "cache/index" + std::to_string(index) + "/";
+				std::ifstream levelFile(cachePath + "level");
+				uint level = 0;
+				if (!(levelFile >> level))
+					break;
+
+				if (level > lastLevel && ReadCpuList(cachePath + "shared_cpu_list", sharedCpus))
+				{
+					lastLevel = level;
+					firstCpu = sharedCpus[0];
+				}
+			}
+			return firstCpu;
+		}
+
+		// With the default scheduler, Linux applies nice values per thread when given a thread id
+		void SetCurrentThreadPriority(WorkerPriority aPriority)
+		{
+			const int nice = aPriority == WorkerPriority::High ? locHighPriorityNice : locLowPriorityNice;
+			setpriority(PRIO_PROCESS, (id_t)gettid(), nice);
+		}
+
+#if DEBUG_BUILD
+		// Linux thread names are limited to 15 characters, the end of aBaseName is cut rather than aSuffix
+		void SetThreadName(std::thread& aThread, const std::string& aBaseName, const std::string& aSuffix)
+		{
+			const std::string name = aBaseName.substr(0, 15 - (std::min)(aSuffix.size(), (size_t)15)) + aSuffix;
+			pthread_setname_np(aThread.native_handle(), name.c_str());
+		}
+#endif
+#endif
+
+		CpuTopology DetectCpuTopology()
+		{
+			CpuTopology topology;
+
+#if LINUX_BUILD
+			cpu_set_t allowedCpus;
+			CPU_ZERO(&allowedCpus);
+			const bool hasAllowedCpus = sched_getaffinity(0, sizeof(allowedCpus), &allowedCpus) == 0;
+
+			// Cores and cache groups are identified by their first logical CPU
+			std::vector<uint> coresFirstCpus;
+			std::vector<uint> cacheGroupsFirstCpus;
+			std::vector<uint> onlineCpus;
+			std::vector<uint> siblings;
+			if (ReadCpuList(locCpusPath + "online", onlineCpus))
+			{
+				for (uint cpu : onlineCpus)
+				{
+					if (hasAllowedCpus && (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowedCpus)))
+						continue;
+
+					const std::string cpuPath = locCpusPath + "cpu" + std::to_string(cpu) + "/";
+					if (!ReadCpuList(cpuPath + "topology/thread_siblings_list", siblings))
+						siblings = { cpu };
+
+					auto coreIt = std::find(coresFirstCpus.begin(), coresFirstCpus.end(), siblings[0]);
+					if (coreIt == coresFirstCpus.end())
+					{
+						const uint cacheFirstCpu = ReadLastCacheFirstCpu(cpuPath, siblings[0]);
+						auto cacheGroupIt = std::find(cacheGroupsFirstCpus.begin(), cacheGroupsFirstCpus.end(), cacheFirstCpu);
+						if (cacheGroupIt == cacheGroupsFirstCpus.end())
+							cacheGroupIt = cacheGroupsFirstCpus.insert(cacheGroupsFirstCpus.end(), cacheFirstCpu);
+
+						coresFirstCpus.push_back(siblings[0]);
+						CpuTopology::Core& core = topology.myCores.emplace_back();
+						core.myCacheGroup = (uint)(cacheGroupIt - cacheGroupsFirstCpus.begin());
+						coreIt = coresFirstCpus.end() - 1;
+					}
+					topology.myCores[coreIt - coresFirstCpus.begin()].myLogicalCpus.push_back(cpu);
+				}
+				topology.myCacheGroupsCount = (std::max)((uint)cacheGroupsFirstCpus.size(), 1u);
+			}
+#endif
+
+			if (topology.myCores.empty())
+			{
+				const uint cpusCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+				for (uint cpu = 0; cpu < cpusCount; ++cpu)
+					topology.myCores.emplace_back().myLogicalCpus.push_back(cpu);
+				topology.myCacheGroupsCount = 1;
+			}
 
-		std::unique_lock<std::mutex> lock(myDoneMutex);
-		myDoneCondition.wait(lock, [this] { return myDone; });
+			std::stable_sort(topology.myCores.begin(), topology.myCores.end(), [](const CpuTopology::Core& aCore, const CpuTopology::Core& anOtherCore) {
+				return aCore.myCacheGroup < anOtherCore.myCacheGroup;
+			});
+			return topology;
+		}
+	}
+
+	const CpuTopology& CpuTopology::Get()
+	{
+		static const CpuTopology topology = DetectCpuTopology();
+		return topology;
+	}
+
+	uint CpuTopology::GetLogicalCpusCount() const
+	{
+		uint count = 0;
+		for (const Core& core : myCores)
+			count += (uint)core.myLogicalCpus.size();
+		return count;
+	}
+
+	void JobData::RemoveReference()
+	{
+		if (myReferencesCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			myPool->FreeJob(this);
 	}
 
-	void JobData::OnDone()
+	void JobData::Wait() const
 	{
+		while (!myDone.load(std::memory_order_acquire))
+			myDone.wait(false, std::memory_order_acquire);
+	}
+
+	void JobData::LockContinuations()
+	{
+		// Only held to add or take a few pointers
+		while (myContinuationsLock.exchange(true, std::memory_order_acquire))
 		{
-			std::lock_guard<std::mutex> lock(myDoneMutex);
-			myDone = true;
+			while (myContinuationsLock.load(std::memory_order_relaxed))
+				std::this_thread::yield();
 		}
+	}
 
-		// In case some threads are waiting for us, tell them to re-evaluate the done state
-		myDoneCondition.notify_all();
+	JobDeque::JobDeque()
+		: myBuffer(new Buffer(64))
+	{
+	}
+
+	JobDeque::~JobDeque()
+	{
+		delete myBuffer.load(std::memory_order_relaxed);
+		for (Buffer* buffer : myRetiredBuffers)
+			delete buffer;
 	}
 
-	WorkerPool::Worker::Worker(WorkerPool* aPool)
+	void JobDeque::Push(JobData* aJob)
+	{
+		const int64 bottom = myBottom.load(std::memory_order_relaxed);
+		const int64 top = myTop.load(std::memory_order_acquire);
+		Buffer* buffer = myBuffer.load(std::memory_order_relaxed);
+		if (bottom - top > buffer->myMask)
+			buffer = Grow(buffer, bottom, top);
+
+		// Released so that a thief reading myBottom sees the job
+		buffer->Put(bottom, aJob);
+		myBottom.store(bottom + 1, std::memory_order_release);
+	}
+
+	JobData* JobDeque::Pop()
+	{
+		const int64 bottom = myBottom.load(std::memory_order_relaxed) - 1;
+		Buffer* buffer = myBuffer.load(std::memory_order_relaxed);
+		myBottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64 top = myTop.load(std::memory_order_relaxed);
+
+		if (top > bottom)
+		{
+			myBottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		JobData* job = buffer->Get(bottom);
+		if (top == bottom)
+		{
+			// Last job, race with the stealers for it
+			if (!myTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = nullptr;
+			myBottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	JobData* JobDeque::Steal()
+	{
+		int64 top = myTop.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64 bottom = myBottom.load(std::memory_order_acquire);
+		if (top >= bottom)
+			return nullptr;
+
+		JobData* job = myBuffer.load(std::memory_order_acquire)->Get(top);
+		if (!myTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return job;
+	}
+
+	JobDeque::Buffer* JobDeque::Grow(Buffer* aBuffer, int64 aBottom, int64 aTop)
+	{
+		Buffer* buffer = new Buffer((aBuffer->myMask + 1) * 2);
+		for (int64 i = aTop; i < aBottom; ++i)
+			buffer->Put(i, aBuffer->Get(i));
+
+		myRetiredBuffers.push_back(aBuffer);
+		myBuffer.store(buffer, std::memory_order_release);
+		return buffer;
+	}
+
+	thread_local WorkerPool::Worker* WorkerPool::ourCurrentWorker = nullptr;
+	thread_local const WorkerPool::RunningJob* WorkerPool::ourRunningJobs = nullptr;
+	thread_local uint WorkerPool::ourHelpDepth = 0;
+	thread_local uint WorkerPool::ourHelperRandomState = 2654435761u;
+
+	WorkerPool::Worker::Worker(WorkerPool* aPool, uint anIndex, uint aLogicalCpu, uint aCacheGroup)
 		: myPool(aPool)
+		, myIndex(anIndex)
+		, myRandomState(anIndex * 2654435761u + 1)
+		, myLogicalCpu(aLogicalCpu)
+		, myCacheGroup(aCacheGroup)
+	{
+	}
+
+	void WorkerPool::Worker::Start()
 	{
 		myWorkerThread = std::thread(&Worker::RunJobs, this);
 
@@ -49,176 +299,609 @@ namespace Thread
 		}
 		SetThreadPriority(myWorkerThread.native_handle(), priority);
 
+		if (myLogicalCpu < 64)
+			SetThreadAffinityMask(myWorkerThread.native_handle(), (DWORD_PTR)1 << myLogicalCpu);
+
 #if DEBUG_BUILD
 		if (!myPool->myWorkersBaseName.empty())
 		{
 			std::wstring workerName = std::wstring(myPool->myWorkersBaseName.begin(), myPool->myWorkersBaseName.end());
 			workerName += L" ";
-			workerName += std::to_wstring(myPool->myWorkers.size());
+			workerName += std::to_wstring(myIndex);
 			SetThreadDescription(myWorkerThread.native_handle(), workerName.c_str());
 		}
 #endif
 
 #elif LINUX_BUILD
-		// TODO
+		// The priority is set by the worker itself, see RunJobs
+
+		if (myLogicalCpu < CPU_SETSIZE)
+		{
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			CPU_SET(myLogicalCpu, &cpus);
+			pthread_setaffinity_np(myWorkerThread.native_handle(), sizeof(cpus), &cpus);
+		}
+
+#if DEBUG_BUILD
+		if (!myPool->myWorkersBaseName.empty())
+			SetThreadName(myWorkerThread, myPool->myWorkersBaseName, " " + std::to_string(myIndex));
+#endif
+
 #endif
 	}
 
 	WorkerPool::Worker::~Worker()
 	{
-		if (myWorkerThread.joinable())
+		Assert(!myWorkerThread.joinable(), "Workers must be stopped by their pool!");
+		for (uint lane = 0; lane < (uint)JobPriority::Count; ++lane)
+			Assert(myDeques[lane].IsEmpty() && myPinnedJobs[lane].empty(), "Jobs remaining in the queue!");
+	}
+
+	bool WorkerPool::Worker::HasPinnedJobs(JobPriority aLowestPriority) const
+	{
+		for (uint lane = 0; lane <= (uint)aLowestPriority; ++lane)
 		{
-			WaitJobs();
+			if (myPinnedJobsCounts[lane] > 0)
+				return true;
+		}
+		return false;
+	}
 
+	void WorkerPool::Worker::RunJobs()
+	{
+		ourCurrentWorker = this;
+
+#if LINUX_BUILD
+		SetCurrentThreadPriority(myPool->myWorkersPriority);
+#endif
+
+		while (true)
+		{
+			if (JobData* job = myPool->FindJob(this, JobPriority::Background))
 			{
-				std::lock_guard<std::mutex> lock(myJobQueueMutex);
-				Assert(myJobQueue.empty(), "Jobs remaining in the queue!");
-				myStopping = true;
+				myPool->RunJob(job);
+				continue;
 			}
 
-			// Tell the worker it should run (so it can end)
-			myWorkToDoCondition.notify_one();
+			std::unique_lock<std::mutex> lock(myPool->mySleepMutex);
+			myPool->mySleepingWorkersCount++;
+			myPool->myWakeCondition.wait(lock, [this] {
+				return myPool->myStopping || myPool->HasQueuedJobs(JobPriority::Background) || HasPinnedJobs(JobPriority::Background);
+			});
+			myPool->mySleepingWorkersCount--;
+			if (myPool->myStopping && !myPool->HasQueuedJobs(JobPriority::Background) && !HasPinnedJobs(JobPriority::Background))
+				break;
+		}
+
+		ourCurrentWorker = nullptr;
+	}
+
+	WorkerPool::WorkerPool(WorkerPriority aPriority /*= WorkerPriority::High*/)
+		: myWorkersPriority(aPriority)
+	{
+	}
+
+	WorkerPool::~WorkerPool()
+	{
+		StopWorkers();
+	}
+
+	void WorkerPool::SetWorkersCount(uint aCount /*= UINT_MAX*/)
+	{
+		// Releasing the workers will cause to wait
+		StopWorkers();
+
+		const CpuTopology& topology = CpuTopology::Get();
+		aCount = (std::min)(aCount, topology.GetLogicalCpusCount());
 
-			myWorkerThread.join();
+		// The cores are sorted by cache group, so the first workers share a cache
+		std::vector<std::pair<uint, uint>> placements;
+		if (myPinWorkersToCores)
+		{
+			for (uint sibling = 0; placements.size() < aCount; ++sibling)
+			{
+				for (const CpuTopology::Core& core : topology.myCores)
+				{
+					if (sibling < core.myLogicalCpus.size() && placements.size() < aCount)
+						placements.push_back({ core.myLogicalCpus[sibling], core.myCacheGroup });
+				}
+			}
 		}
+
+		myWorkers.reserve(aCount);
+		for (uint i = 0; i < aCount; ++i)
+		{
+			if (myPinWorkersToCores)
+				myWorkers.push_back(std::make_unique<Worker>(this, i, placements[i].first, placements[i].second));
+			else
+				myWorkers.push_back(std::make_unique<Worker>(this, i, UINT_MAX, 0));
+		}
+
+		// Started once they are all created, workers look for jobs to steal in myWorkers
+		for (const std::unique_ptr<Worker>& worker : myWorkers)
+			worker->Start();
 	}
 
-	void WorkerPool::Worker::AssignJob(JobHandle aJob)
+	JobPriority WorkerPool::GetCurrentJobPriority() const
 	{
+		for (const RunningJob* running = ourRunningJobs; running; running = running->myPrevious)
 		{
-			std::lock_guard<std::mutex> lock(myJobQueueMutex);
-			myJobQueue.push(aJob);
+			if (running->myJob->myPool == this)
+				return running->myJob->myPriority;
 		}
+		return JobPriority::Normal;
+	}
 
-		// Tell the worker it has work to do
-		myWorkToDoCondition.notify_one();
+	JobHandle WorkerPool::CreateJobGroup(JobPriority aPriority /*= JobPriority::Normal*/)
+	{
+		JobData* group = AllocateJob();
+		group->myPriority = aPriority;
+		myOpenGroupsCount++;
+		return JobHandle(group);
 	}
 
-	void WorkerPool::Worker::NotifyWaitingJobs()
+	void WorkerPool::AddToJobGroup(const JobHandle& aGroup, const JobHandle& aJob)
 	{
-		// Tell the worker there is work waiting
-		myWorkToDoCondition.notify_one();
+		Assert(!aGroup.myJob->myFunction, "Adding a job to a job that is not a group!");
+		AddDependency(aGroup.myJob, aJob.myJob);
 	}
 
-	void WorkerPool::Worker::WaitJobs()
+	void WorkerPool::CloseJobGroup(const JobHandle& aGroup)
 	{
-		std::unique_lock<std::mutex> lock(myJobQueueMutex);
-		myWaitForJobsCondition.wait(lock, [this] { return !EvaluateWorkToDo(); });
+		myOpenGroupsCount--;
+		ReleaseDependency(aGroup.myJob);
 	}
 
-	void WorkerPool::Worker::RunJobs()
+	void WorkerPool::WaitForJob(const JobHandle& aJobHandle)
 	{
+		JobData* job = aJobHandle.myJob;
+		if (job->myDone.load(std::memory_order_acquire))
+			return;
+
+		for (const RunningJob* running = ourRunningJobs; running; running = running->myPrevious)
+			Assert(running->myJob != job, "A job is waiting for itself!");
+
+		// Past the max depth, the stack is mostly made of jobs run while waiting, stop taking more
+		if (myWorkers.empty() || ourHelpDepth >= ourMaxHelpDepth)
+		{
+			job->Wait();
+			return;
+		}
+
+		HelpUntilDone(job);
+	}
+
+	void WorkerPool::WaitIdle()
+	{
+		for (const RunningJob* running = ourRunningJobs; running; running = running->myPrevious)
+			Assert(running->myJob->myPool != this, "WaitIdle called from a job, it would wait for itself!");
+
+		HelpUntilDone(nullptr);
+	}
+
+	void WorkerPool::HelpUntilDone(JobData* aJob)
+	{
+		Worker* worker = ourCurrentWorker && ourCurrentWorker->myPool == this ? ourCurrentWorker : nullptr;
+		if (worker)
+			myWaitingWorkersCount++;
+
+		// Running a long background job while the frame waits for a critical one is what the lanes avoid
+		// When all the workers are waiting though, nobody else would run the lanes the awaited job may depend on
+		const JobPriority priority = aJob ? aJob->myPriority : JobPriority::Background;
+		auto getLowestPriority = [this, priority]() {
+			return myWaitingWorkersCount == myWorkers.size() ? JobPriority::Background : priority;
+		};
+
+		ourHelpDepth++;
+		while (!IsWaitDone(aJob))
+		{
+			if (JobData* job = FindJob(worker, getLowestPriority()))
+			{
+				RunJob(job);
+				continue;
+			}
+
+			if (!aJob && IsIdleWaitStalled())
+			{
+				Assert(false, "Waiting for jobs that depend on a job group that is still open!");
+				break;
+			}
+
+			// Nothing to take, sleep like a worker until there is or the wait is over
+			std::atomic<uint>& waitersCount = aJob ? aJob->myWaitersCount : myIdleWaitersCount;
+			waitersCount++;
+			{
+				std::unique_lock<std::mutex> lock(mySleepMutex);
+				mySleepingWorkersCount++;
+				mySleepingHelpersCount++;
+				myWakeCondition.wait(lock, [this, aJob, worker, &getLowestPriority] {
+					return IsWaitDone(aJob) || HasQueuedJobs(getLowestPriority()) || (worker && worker->HasPinnedJobs(getLowestPriority())) || (!aJob && IsIdleWaitStalled());
+				});
+				mySleepingHelpersCount--;
+				mySleepingWorkersCount--;
+			}
+			waitersCount--;
+		}
+		ourHelpDepth--;
+
+		if (worker)
+			myWaitingWorkersCount--;
+
+		// The wake up meant for a worker may have been taken by this thread, pass it on
+		if (HasQueuedJobs(JobPriority::Background))
+			WakeWorkers(false);
+	}
+
+	JobData* WorkerPool::AllocateJob()
+	{
+		uint64 head = myFreeJobsHead.load(std::memory_order_acquire);
 		while (true)
 		{
-			JobHandle nextJob;
+			const uint index = (uint)head;
+			if (index == UINT_MAX)
+			{
+				AddJobsBlock();
+				head = myFreeJobsHead.load(std::memory_order_acquire);
+				continue;
+			}
 
+			// The next index may be stale if another thread took the job first, the tag makes the exchange fail then
+			JobData* job = GetJob(index);
+			const uint64 newHead = (((head >> 32) + 1) << 32) | job->myNextFreeIndex.load(std::memory_order_relaxed);
+			if (myFreeJobsHead.compare_exchange_weak(head, newHead, std::memory_order_acquire, std::memory_order_acquire))
 			{
-				std::unique_lock<std::mutex> lock(myJobQueueMutex);
-				myWorkToDoCondition.wait(lock, [this] { return EvaluateWorkToDo(); });
-				if (myStopping)
-				{
-					Assert(myJobQueue.empty(), "Jobs remaining in the queue!");
-					break;
-				}
-				nextJob = myJobQueue.front();
+				// One reference for the pool until the job is done, one dependency until it is submitted
+				job->myReferencesCount.store(1, std::memory_order_relaxed);
+				job->myDependenciesCount.store(1, std::memory_order_relaxed);
+				job->myDone.store(false, std::memory_order_relaxed);
+				job->myWorkIndex = UINT_MAX;
+				job->myPriority = JobPriority::Normal;
+				return job;
 			}
+		}
+	}
+
+	void WorkerPool::FreeJob(JobData* aJob)
+	{
+		aJob->myFunction.Reset();
+		aJob->myContinuations.clear();
+
+		uint64 head = myFreeJobsHead.load(std::memory_order_relaxed);
+		do
+		{
+			aJob->myNextFreeIndex.store((uint)head, std::memory_order_relaxed);
+		} while (!myFreeJobsHead.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | aJob->myIndex, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	void WorkerPool::AddJobsBlock()
+	{
+		std::lock_guard<std::mutex> lock(myJobsBlocksMutex);
+
+		// Another thread may have added a block in the meantime
+		if ((uint)myFreeJobsHead.load(std::memory_order_acquire) != UINT_MAX)
+			return;
+
+		Assert(myJobsBlocksCount < ourMaxJobsBlocks, "Too many jobs in flight!");
+		const uint firstIndex = myJobsBlocksCount * ourJobsBlockSize;
+		myJobsBlocks[myJobsBlocksCount] = std::make_unique<JobData[]>(ourJobsBlockSize);
+		myJobsBlocksCount++;
 
-			nextJob->myFunction();
-			nextJob->OnDone();
+		for (uint i = 0; i < ourJobsBlockSize; ++i)
+		{
+			JobData* job = GetJob(firstIndex + i);
+			job->myPool = this;
+			job->myIndex = firstIndex + i;
+			job->myNextFreeIndex.store(i + 1 < ourJobsBlockSize ? firstIndex + i + 1 : UINT_MAX, std::memory_order_relaxed);
+		}
+
+		// Chain the block in front of the jobs freed since
+		JobData* lastJob = GetJob(firstIndex + ourJobsBlockSize - 1);
+		uint64 head = myFreeJobsHead.load(std::memory_order_relaxed);
+		do
+		{
+			lastJob->myNextFreeIndex.store((uint)head, std::memory_order_relaxed);
+		} while (!myFreeJobsHead.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | firstIndex, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	JobHandle WorkerPool::SubmitJob(JobData* aJob, std::span<const JobHandle> someDependencies)
+	{
+		JobHandle jobHandle(aJob);
+		if (aJob->myFunction)
+		{
+			myPendingJobsCount++;
+			myBlockedJobsCount++;
+		}
+
+		for (const JobHandle& dependency : someDependencies)
+			AddDependency(aJob, dependency.myJob);
+
+		// Submitted, queued right away if the dependencies are already done
+		ReleaseDependency(aJob);
+		return jobHandle;
+	}
+
+	JobData* WorkerPool::PopInjectedJob(uint aLane)
+	{
+		std::lock_guard<std::mutex> lock(myInjectedJobsMutex);
+		if (myInjectedJobs[aLane].empty())
+			return nullptr;
+
+		JobData* job = myInjectedJobs[aLane].front();
+		myInjectedJobs[aLane].pop();
+		myQueuedJobsCounts[aLane]--;
+		return job;
+	}
+
+	JobData* WorkerPool::FindJob(Worker* aWorker, JobPriority aLowestPriority)
+	{
+		if (myWorkers.empty())
+			return nullptr;
 
+		const uint backgroundLane = (uint)JobPriority::Background;
+		const uint lowestLane = (uint)aLowestPriority;
+
+		// Background jobs waited long enough, they get one turn ahead of the other lanes
+		if (lowestLane >= backgroundLane && myBackgroundSkipsCount >= ourMaxBackgroundSkips && myBackgroundSkipsCount.exchange(0) >= ourMaxBackgroundSkips)
+		{
+			if (JobData* job = FindJobInLane(aWorker, backgroundLane))
+				return job;
+		}
+
+		for (uint lane = 0; lane <= lowestLane; ++lane)
+		{
+			if (JobData* job = FindJobInLane(aWorker, lane))
 			{
-				std::lock_guard<std::mutex> lock(myJobQueueMutex);
-				myJobQueue.pop();
+				if (lane < backgroundLane && myQueuedJobsCounts[backgroundLane] > 0)
+					myBackgroundSkipsCount++;
+				return job;
 			}
+		}
+		return nullptr;
+	}
 
-			// In case some threads are waiting for our jobs, tell them to re-evaluate the state of the queue
-			myWaitForJobsCondition.notify_all();
+	JobData* WorkerPool::FindJobInLane(Worker* aWorker, uint aLane)
+	{
+		if (aWorker && aWorker->myPinnedJobsCounts[aLane] > 0)
+		{
+			std::lock_guard<std::mutex> lock(aWorker->myPinnedJobsMutex);
+			std::queue<JobData*>& pinnedJobs = aWorker->myPinnedJobs[aLane];
+			if (!pinnedJobs.empty())
+			{
+				JobData* job = pinnedJobs.front();
+				pinnedJobs.pop();
+				aWorker->myPinnedJobsCounts[aLane]--;
+				return job;
+			}
+		}
+
+		if (myQueuedJobsCounts[aLane] == 0)
+			return nullptr;
+
+		if (aWorker)
+		{
+			if (JobData* job = aWorker->myDeques[aLane].Pop())
+			{
+				myQueuedJobsCounts[aLane]--;
+				return job;
+			}
 		}
+
+		if (JobData* job = PopInjectedJob(aLane))
+			return job;
+
+		// Other threads have no deque, and can't take the pinned jobs
+		return StealJob(aWorker ? aWorker->myRandomState : ourHelperRandomState, aWorker, aLane);
 	}
 
-	bool WorkerPool::Worker::EvaluateWorkToDo()
+	JobData* WorkerPool::StealJob(uint& aRandomState, const Worker* aThief, uint aLane)
 	{
-		if (myStopping)
-			return true;
+		// Start from a random victim so that the thieves spread over the workers
+		aRandomState ^= aRandomState << 13;
+		aRandomState ^= aRandomState >> 17;
+		aRandomState ^= aRandomState << 5;
+
+		// Workers first steal from the ones sharing their cache, then from the others
+		const uint workersCount = (uint)myWorkers.size();
+		const uint start = aRandomState % workersCount;
+		for (uint pass = aThief ? 0 : 1; pass < 2; ++pass)
+		{
+			for (uint i = 0; i < workersCount; ++i)
+			{
+				Worker& victim = *myWorkers[(start + i) % workersCount];
+				if (&victim == aThief)
+					continue;
 
-		if (!myJobQueue.empty())
-			return true;
+				const bool isSameCacheGroup = aThief && victim.myCacheGroup == aThief->myCacheGroup;
+				if (isSameCacheGroup != (pass == 0))
+					continue;
 
-		if (myPool->AssignJobTo(this))
-			return true;
+				if (JobData* job = victim.myDeques[aLane].Steal())
+				{
+					myQueuedJobsCounts[aLane]--;
+					return job;
+				}
+			}
+		}
+		return nullptr;
+	}
 
+	bool WorkerPool::HasQueuedJobs(JobPriority aLowestPriority) const
+	{
+		for (uint lane = 0; lane <= (uint)aLowestPriority; ++lane)
+		{
+			if (myQueuedJobsCounts[lane] > 0)
+				return true;
+		}
 		return false;
 	}
 
-	WorkerPool::WorkerPool(WorkerPriority aPriority /*= WorkerPriority::High*/)
-		: myWorkersPriority(aPriority)
+	bool WorkerPool::IsIdleWaitStalled() const
 	{
+		if (myOpenGroupsCount == 0 || myRunningJobsCount > 0 || myCrossPoolDependenciesCount > 0 || HasQueuedJobs(JobPriority::Background))
+			return false;
+
+		for (const std::unique_ptr<Worker>& worker : myWorkers)
+		{
+			if (worker->HasPinnedJobs(JobPriority::Background))
+				return false;
+		}
+
+		// Jobs stop being blocked before they are queued, a pending job that isn't blocked is about to be queued or run
+		return myPendingJobsCount == myBlockedJobsCount;
 	}
 
-	void WorkerPool::SetWorkersCount(uint aCount /*= UINT_MAX*/)
+	void WorkerPool::AddDependency(JobData* aJob, JobData* aDependency)
 	{
-		// Releasing the workers will cause to wait
-		myWorkers.clear();
-
-		aCount = (std::min)(aCount, std::thread::hardware_concurrency());
-		myWorkers.reserve(aCount);
-		for (uint i = 0; i < aCount; ++i)
+		aDependency->LockContinuations();
+		if (!aDependency->myDone.load(std::memory_order_relaxed))
 		{
-			myWorkers.push_back(std::make_unique<Worker>(this));
+			aJob->myDependenciesCount++;
+			if (aDependency->myPool != aJob->myPool)
+				aJob->myPool->myCrossPoolDependenciesCount++;
+			aDependency->myContinuations.push_back(aJob);
 		}
+		aDependency->UnlockContinuations();
 	}
 
-	JobHandle WorkerPool::RequestJob(std::function<void()> aJob, uint aWorkIndex /*= UINT_MAX*/)
+	void WorkerPool::ReleaseDependency(JobData* aJob)
 	{
-		JobHandle jobHandle = std::make_shared<JobData>();
-		jobHandle->myFunction = std::move(aJob);
-		
-		if (aWorkIndex < myWorkers.size())
+		if (--aJob->myDependenciesCount == 0)
+			ScheduleJob(aJob);
+	}
+
+	void WorkerPool::ScheduleJob(JobData* aJob)
+	{
+		// Groups have nothing to run
+		if (!aJob->myFunction)
 		{
-			myWorkers[aWorkIndex]->AssignJob(jobHandle);
-			return jobHandle;
+			FinishJob(aJob);
+			return;
 		}
+		myBlockedJobsCount--;
 
-		// Put the job in a waiting queue, and the first worker that is done with its jobs will pick it.
+		if (myWorkers.empty())
 		{
-			std::lock_guard<std::mutex> lock(myWaitingJobQueueMutex);
-			myWaitingJobQueue.push(jobHandle);
+			RunJob(aJob);
+			return;
 		}
 
-		// Notify the workers there is work waiting.
-		for (uint i = 0; i < myWorkers.size(); ++i)
+		if (aJob->myWorkIndex < myWorkers.size())
 		{
-			myWorkers[i]->NotifyWaitingJobs();
+			Worker& worker = *myWorkers[aJob->myWorkIndex];
+			{
+				std::lock_guard<std::mutex> lock(worker.myPinnedJobsMutex);
+				worker.myPinnedJobs[(uint)aJob->myPriority].push(aJob);
+			}
+			worker.myPinnedJobsCounts[(uint)aJob->myPriority]++;
+
+			// Only this worker can take it
+			WakeWorkers(true);
+			return;
 		}
 
-		return jobHandle;
+		const uint lane = (uint)aJob->myPriority;
+		if (ourCurrentWorker && ourCurrentWorker->myPool == this)
+		{
+			ourCurrentWorker->myDeques[lane].Push(aJob);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(myInjectedJobsMutex);
+			myInjectedJobs[lane].push(aJob);
+		}
+		myQueuedJobsCounts[lane]++;
+
+		WakeWorkers(false);
 	}
 
-	void WorkerPool::WaitForJob(JobHandle aJobHandle)
+	void WorkerPool::RunJob(JobData* aJob)
 	{
-		aJobHandle->Wait();
+		myRunningJobsCount++;
+		const RunningJob running{ aJob, ourRunningJobs };
+		ourRunningJobs = &running;
+		aJob->myFunction();
+		ourRunningJobs = running.myPrevious;
+
+		// Releases what the function captured before the job is recycled
+		aJob->myFunction.Reset();
+		FinishJob(aJob);
+
+		// Still running until done with the counts, so that the last job to finish sees the stall
+		const uint pendingJobsCount = --myPendingJobsCount;
+		myRunningJobsCount--;
+		if (myIdleWaitersCount > 0 && (pendingJobsCount == 0 || IsIdleWaitStalled()))
+		{
+			// Lock so that WaitIdle can't miss the notification between its check and its wait
+			{
+				std::lock_guard<std::mutex> lock(mySleepMutex);
+			}
+			myWakeCondition.notify_all();
+		}
 	}
 
-	void WorkerPool::WaitIdle()
+	void WorkerPool::FinishJob(JobData* aJob)
 	{
-		for (uint i = 0; i < myWorkers.size(); ++i)
+		// No continuation can be added once the job is marked as done
+		aJob->LockContinuations();
+		aJob->myDone.store(true, std::memory_order_seq_cst);
+		aJob->UnlockContinuations();
+		aJob->myDone.notify_all();
+
+		// Ordered with the increment of the waiters count, either the waiter sees the job done or it is seen here
+		if (aJob->myWaitersCount.load(std::memory_order_seq_cst) > 0)
 		{
-			myWorkers[i]->WaitJobs();
+			{
+				std::lock_guard<std::mutex> lock(mySleepMutex);
+			}
+			myWakeCondition.notify_all();
 		}
+
+		// Continuations may belong to another pool, they are scheduled on theirs
+		for (JobData* continuation : aJob->myContinuations)
+		{
+			WorkerPool* pool = continuation->myPool;
+			if (pool != this)
+				pool->myCrossPoolDependenciesCount--;
+			pool->ReleaseDependency(continuation);
+		}
+
+		aJob->RemoveReference();
 	}
 
-	bool WorkerPool::AssignJobTo(Worker* aWorker)
+	void WorkerPool::WakeWorkers(bool anAll)
 	{
-		std::lock_guard<std::mutex> lock(myWaitingJobQueueMutex);
+		if (mySleepingWorkersCount == 0)
+			return;
 
-		if (myWaitingJobQueue.empty())
-			return false;
+		// Lock so that a worker can't miss the notification between its check and its wait
+		{
+			std::lock_guard<std::mutex> lock(mySleepMutex);
+		}
+		if (anAll || mySleepingHelpersCount > 0)
+			myWakeCondition.notify_all();
+		else
+			myWakeCondition.notify_one();
+	}
 
-		// This is called by the worker thread, and the worker mutex is already locked at this point
-		aWorker->myJobQueue.push(myWaitingJobQueue.front());
+	void WorkerPool::StopWorkers()
+	{
+		if (myWorkers.empty())
+			return;
+
+		WaitIdle();
+
+		{
+			std::lock_guard<std::mutex> lock(mySleepMutex);
+			myStopping = true;
+		}
+		myWakeCondition.notify_all();
 
-		myWaitingJobQueue.pop();
-		return true;
+		// Workers may steal from each other until they all stopped
+		for (const std::unique_ptr<Worker>& worker : myWorkers)
+			worker->myWorkerThread.join();
+		myWorkers.clear();
+		myStopping = false;
 	}
 
 	void WorkerThread::Start(std::function<void()> aFunction, WorkerPriority aPriority, uint aSleepIntervalMs /*= 16*/)
@@ -226,6 +909,7 @@ namespace Thread
 		StopAndWait();
 
 		myFunction = std::move(aFunction);
+		myPriority = aPriority;
 		mySleepIntervalMs = aSleepIntervalMs;
 		myThread = std::thread(&WorkerThread::Run, this);
 
@@ -254,7 +938,13 @@ namespace Thread
 #endif
 
 #elif LINUX_BUILD
-		// TODO
+		// The priority is set by the thread itself, see Run
+
+#if DEBUG_BUILD
+		if (!myThreadName.empty())
+			SetThreadName(myThread, myThreadName, "");
+#endif
+
 #endif
 	}
 
@@ -270,6 +960,10 @@ namespace Thread
 
 	void WorkerThread::Run()
 	{
+#if LINUX_BUILD
+		SetCurrentThreadPriority(myPriority);
+#endif
+
 		while (!myStopRequested)
 		{
 			myFunction();
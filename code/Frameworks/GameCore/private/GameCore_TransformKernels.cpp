@@ -0,0 +1,220 @@
+#include "GameCore_TransformKernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TRANSFORM_KERNELS_SIMD 1
+#include <immintrin.h>
+#if WINDOWS_BUILD
+#include <intrin.h>
+#endif
+#else
+#define TRANSFORM_KERNELS_SIMD 0
+#endif
+
+// SSE2 is always available on x64, AVX functions are compiled separately and only called when the CPU supports them
+#if defined(__GNUC__) || defined(__clang__)
+#define TRANSFORM_KERNELS_AVX __attribute__((target("avx")))
+#else
+#define TRANSFORM_KERNELS_AVX
+#endif
+
+namespace GameCore
+{
+	namespace TransformKernels
+	{
+		namespace
+		{
+#if TRANSFORM_KERNELS_SIMD
+			bool HasAVX()
+			{
+#if WINDOWS_BUILD
+				int info[4];
+				__cpuid(info, 1);
+				const bool usesXSave = (info[2] & (1 << 27)) != 0;
+				const bool hasAVX = (info[2] & (1 << 28)) != 0;
+				return usesXSave && hasAVX && (_xgetbv(0) & 6) == 6;
+#else
+				return __builtin_cpu_supports("avx");
+#endif
+			}
+
+			const bool locHasAVX = HasAVX();
+
+			// Deinterleaves 4 vec3 into one register per coordinate
+			inline void LoadVec3x4(const glm::vec3* someVectors, __m128& anOutX, __m128& anOutY, __m128& anOutZ)
+			{
+				const float* data = &someVectors[0].x;
+				const __m128 a0 = _mm_loadu_ps(data);     // x0 y0 z0 x1
+				const __m128 a1 = _mm_loadu_ps(data + 4); // y1 z1 x2 y2
+				const __m128 a2 = _mm_loadu_ps(data + 8); // z2 x3 y3 z3
+
+				const __m128 x23 = _mm_shuffle_ps(a1, a2, _MM_SHUFFLE(1, 1, 2, 2));
+				anOutX = _mm_shuffle_ps(a0, x23, _MM_SHUFFLE(2, 0, 3, 0));
+				const __m128 y01 = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(0, 0, 1, 1));
+				const __m128 y23 = _mm_shuffle_ps(a1, a2, _MM_SHUFFLE(2, 2, 3, 3));
+				anOutY = _mm_shuffle_ps(y01, y23, _MM_SHUFFLE(2, 0, 2, 0));
+				const __m128 z01 = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(1, 1, 2, 2));
+				anOutZ = _mm_shuffle_ps(z01, a2, _MM_SHUFFLE(3, 0, 2, 0));
+			}
+
+			inline void LoadQuatx4(const glm::quat* someQuats, __m128& anOutX, __m128& anOutY, __m128& anOutZ, __m128& anOutW)
+			{
+				// glm stores quaternions as x, y, z, w
+				anOutX = _mm_loadu_ps(&someQuats[0].x);
+				anOutY = _mm_loadu_ps(&someQuats[1].x);
+				anOutZ = _mm_loadu_ps(&someQuats[2].x);
+				anOutW = _mm_loadu_ps(&someQuats[3].x);
+				_MM_TRANSPOSE4_PS(anOutX, anOutY, anOutZ, anOutW);
+			}
+
+			// Stores aRow of 4 matrices, given one register per column
+			inline void StoreRowx4(__m128 aColumn0, __m128 aColumn1, __m128 aColumn2, __m128 aColumn3, uint aRow, AffineMatrix* someOutMatrices)
+			{
+				_MM_TRANSPOSE4_PS(aColumn0, aColumn1, aColumn2, aColumn3);
+				_mm_storeu_ps(&someOutMatrices[0].myRows[aRow].x, aColumn0);
+				_mm_storeu_ps(&someOutMatrices[1].myRows[aRow].x, aColumn1);
+				_mm_storeu_ps(&someOutMatrices[2].myRows[aRow].x, aColumn2);
+				_mm_storeu_ps(&someOutMatrices[3].myRows[aRow].x, aColumn3);
+			}
+
+			// Returns the number of matrices computed, the remainder is left to the scalar version
+			uint ComputeMatricesSSE(const glm::vec3* somePositions, const glm::quat* someOrientations, const glm::vec3* someScales, uint aCount, bool anInvertScale, AffineMatrix* someOutMatrices)
+			{
+				const __m128 one = _mm_set1_ps(1.0f);
+				const __m128 two = _mm_set1_ps(2.0f);
+
+				uint i = 0;
+				for (; i + 4 <= aCount; i += 4)
+				{
+					__m128 px = _mm_setzero_ps(), py = _mm_setzero_ps(), pz = _mm_setzero_ps();
+					if (somePositions)
+						LoadVec3x4(somePositions + i, px, py, pz);
+					__m128 qx, qy, qz, qw;
+					LoadQuatx4(someOrientations + i, qx, qy, qz, qw);
+					__m128 sx, sy, sz;
+					LoadVec3x4(someScales + i, sx, sy, sz);
+					if (anInvertScale)
+					{
+						sx = _mm_div_ps(one, sx);
+						sy = _mm_div_ps(one, sy);
+						sz = _mm_div_ps(one, sz);
+					}
+
+					const __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+					const __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+					const __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+					const __m128 r00 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+					const __m128 r01 = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+					const __m128 r02 = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+					const __m128 r10 = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+					const __m128 r11 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+					const __m128 r12 = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+					const __m128 r20 = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+					const __m128 r21 = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+					const __m128 r22 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+					StoreRowx4(_mm_mul_ps(r00, sx), _mm_mul_ps(r01, sy), _mm_mul_ps(r02, sz), px, 0, someOutMatrices + i);
+					StoreRowx4(_mm_mul_ps(r10, sx), _mm_mul_ps(r11, sy), _mm_mul_ps(r12, sz), py, 1, someOutMatrices + i);
+					StoreRowx4(_mm_mul_ps(r20, sx), _mm_mul_ps(r21, sy), _mm_mul_ps(r22, sz), pz, 2, someOutMatrices + i);
+				}
+				return i;
+			}
+
+			TRANSFORM_KERNELS_AVX inline __m256 Combine(__m128 aLow, __m128 aHigh)
+			{
+				return _mm256_insertf128_ps(_mm256_castps128_ps256(aLow), aHigh, 1);
+			}
+
+			TRANSFORM_KERNELS_AVX inline void StoreRowx8(__m256 aColumn0, __m256 aColumn1, __m256 aColumn2, __m256 aColumn3, uint aRow, AffineMatrix* someOutMatrices)
+			{
+				StoreRowx4(_mm256_castps256_ps128(aColumn0), _mm256_castps256_ps128(aColumn1), _mm256_castps256_ps128(aColumn2), _mm256_castps256_ps128(aColumn3), aRow, someOutMatrices);
+				StoreRowx4(_mm256_extractf128_ps(aColumn0, 1), _mm256_extractf128_ps(aColumn1, 1), _mm256_extractf128_ps(aColumn2, 1), _mm256_extractf128_ps(aColumn3, 1), aRow, someOutMatrices + 4);
+			}
+
+			// Same as the SSE version, 8 matrices at a time
+			TRANSFORM_KERNELS_AVX uint ComputeMatricesAVX(const glm::vec3* somePositions, const glm::quat* someOrientations, const glm::vec3* someScales, uint aCount, bool anInvertScale, AffineMatrix* someOutMatrices)
+			{
+				const __m256 one = _mm256_set1_ps(1.0f);
+				const __m256 two = _mm256_set1_ps(2.0f);
+
+				uint i = 0;
+				for (; i + 8 <= aCount; i += 8)
+				{
+					__m256 px = _mm256_setzero_ps(), py = _mm256_setzero_ps(), pz = _mm256_setzero_ps();
+					if (somePositions)
+					{
+						__m128 lowX, lowY, lowZ, highX, highY, highZ;
+						LoadVec3x4(somePositions + i, lowX, lowY, lowZ);
+						LoadVec3x4(somePositions + i + 4, highX, highY, highZ);
+						px = Combine(lowX, highX);
+						py = Combine(lowY, highY);
+						pz = Combine(lowZ, highZ);
+					}
+
+					__m128 lowQX, lowQY, lowQZ, lowQW, highQX, highQY, highQZ, highQW;
+					LoadQuatx4(someOrientations + i, lowQX, lowQY, lowQZ, lowQW);
+					LoadQuatx4(someOrientations + i + 4, highQX, highQY, highQZ, highQW);
+					const __m256 qx = Combine(lowQX, highQX), qy = Combine(lowQY, highQY), qz = Combine(lowQZ, highQZ), qw = Combine(lowQW, highQW);
+
+					__m128 lowSX, lowSY, lowSZ, highSX, highSY, highSZ;
+					LoadVec3x4(someScales + i, lowSX, lowSY, lowSZ);
+					LoadVec3x4(someScales + i + 4, highSX, highSY, highSZ);
+					__m256 sx = Combine(lowSX, highSX), sy = Combine(lowSY, highSY), sz = Combine(lowSZ, highSZ);
+					if (anInvertScale)
+					{
+						sx = _mm256_div_ps(one, sx);
+						sy = _mm256_div_ps(one, sy);
+						sz = _mm256_div_ps(one, sz);
+					}
+
+					const __m256 xx = _mm256_mul_ps(qx, qx), yy = _mm256_mul_ps(qy, qy), zz = _mm256_mul_ps(qz, qz);
+					const __m256 xy = _mm256_mul_ps(qx, qy), xz = _mm256_mul_ps(qx, qz), yz = _mm256_mul_ps(qy, qz);
+					const __m256 wx = _mm256_mul_ps(qw, qx), wy = _mm256_mul_ps(qw, qy), wz = _mm256_mul_ps(qw, qz);
+
+					const __m256 r00 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz)));
+					const __m256 r01 = _mm256_mul_ps(two, _mm256_sub_ps(xy, wz));
+					const __m256 r02 = _mm256_mul_ps(two, _mm256_add_ps(xz, wy));
+					const __m256 r10 = _mm256_mul_ps(two, _mm256_add_ps(xy, wz));
+					const __m256 r11 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz)));
+					const __m256 r12 = _mm256_mul_ps(two, _mm256_sub_ps(yz, wx));
+					const __m256 r20 = _mm256_mul_ps(two, _mm256_sub_ps(xz, wy));
+					const __m256 r21 = _mm256_mul_ps(two, _mm256_add_ps(yz, wx));
+					const __m256 r22 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy)));
+
+					StoreRowx8(_mm256_mul_ps(r00, sx), _mm256_mul_ps(r01, sy), _mm256_mul_ps(r02, sz), px, 0, someOutMatrices + i);
+					StoreRowx8(_mm256_mul_ps(r10, sx), _mm256_mul_ps(r11, sy), _mm256_mul_ps(r12, sz), py, 1, someOutMatrices + i);
+					StoreRowx8(_mm256_mul_ps(r20, sx), _mm256_mul_ps(r21, sy), _mm256_mul_ps(r22, sz), pz, 2, someOutMatrices + i);
+				}
+				return i;
+			}
+#endif
+
+			void ComputeMatrices(const glm::vec3* somePositions, const glm::quat* someOrientations, const glm::vec3* someScales, uint aCount, bool anInvertScale, AffineMatrix* someOutMatrices)
+			{
+				uint i = 0;
+#if TRANSFORM_KERNELS_SIMD
+				if (locHasAVX)
+					i = ComputeMatricesAVX(somePositions, someOrientations, someScales, aCount, anInvertScale, someOutMatrices);
+				i += ComputeMatricesSSE(somePositions ? somePositions + i : nullptr, someOrientations + i, someScales + i, aCount - i, anInvertScale, someOutMatrices + i);
+#endif
+				for (; i < aCount; ++i)
+				{
+					const glm::vec3 position = somePositions ? somePositions[i] : glm::vec3(0.0f);
+					const glm::vec3 scale = anInvertScale ? 1.0f / someScales[i] : someScales[i];
+					someOutMatrices[i] = ComputeAffineMatrix(position, someOrientations[i], scale);
+				}
+			}
+		}
+
+		void ComputeAffineMatrices(const glm::vec3* somePositions, const glm::quat* someOrientations, const glm::vec3* someScales, uint aCount, AffineMatrix* someOutMatrices)
+		{
+			ComputeMatrices(somePositions, someOrientations, someScales, aCount, false, someOutMatrices);
+		}
+
+		void ComputeNormalMatrices(const glm::quat* someOrientations, const glm::vec3* someScales, uint aCount, AffineMatrix* someOutMatrices)
+		{
+			// The rotation is orthonormal and the scale diagonal, so the inverse transpose is the rotation times the inverse scale
+			ComputeMatrices(nullptr, someOrientations, someScales, aCount, true, someOutMatrices);
+		}
+	}
+}
@@ -28,8 +28,9 @@ namespace GameCore
 			return EntityModule::GetInstance()->HasComponent<T>(myId);
 		}
 
+		// Marks the component as changed, use ReadComponent when only reading it
 		template<typename T>
-		inline T* GetComponent()
+		inline auto* GetComponent()
 		{
 			return EntityModule::GetInstance()->GetComponent<T>(myId);
 		}
@@ -37,11 +38,17 @@ namespace GameCore
 		template<typename T>
 		inline const T* GetComponent() const
 		{
-			return EntityModule::GetInstance()->GetComponent<T>(myId);
+			return static_cast<const EntityModule*>(EntityModule::GetInstance())->GetComponent<T>(myId);
+		}
+
+		template<typename T>
+		inline const T* ReadComponent() const
+		{
+			return EntityModule::GetInstance()->ReadComponent<T>(myId);
 		}
 
 		template<typename T, typename... Args>
-		inline T* AddComponent(Args&&... someArgs)
+		inline auto AddComponent(Args&&... someArgs)
 		{
 			return EntityModule::GetInstance()->AddComponent<T>(myId, std::forward<Args>(someArgs)...);
 		}
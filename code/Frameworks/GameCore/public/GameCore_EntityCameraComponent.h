@@ -6,6 +6,8 @@ namespace GameCore
 	{
 	public:
 		EntityCameraComponent();
+		EntityCameraComponent(EntityCameraComponent&& anOther);
+		EntityCameraComponent(const EntityCameraComponent&) = delete;
 		~EntityCameraComponent();
 
 		void Update();
@@ -16,6 +18,8 @@ namespace GameCore
 		void SetFov(float aFov) { myFov = aFov; }
 		void SetNearFar(float aZNear, float aZFar) { myZNear = aZNear; myZFar = aZFar; }
 
+		const glm::vec3& GetPosition() const { return myPosition; }
+
 		glm::mat4 GetViewMatrix() const { return glm::lookAt(myPosition, myPosition + myDirection, myUp); }
 		glm::mat4 GetPerspectiveMatrix() const
 		{
@@ -25,6 +29,8 @@ namespace GameCore
 		}
 
 	private:
+		void AddScrollCallback();
+
 		float myAspectRatio = 1.0f;
 		float myFov = 45.0f;
 		float myZNear = 0.1f;
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "GameCore_EntityModule.h"
+
+#include <atomic>
+#include <optional>
+
+namespace GameCore
+{
+	// Records structural changes to apply them later in one go, ie: while iterating on a container or from a system running on a worker
+	// Commands are applied grouped by component type: creations first, then the components in component id order, then destructions
+	// Commands on entities that don't exist anymore when the buffer is applied are skipped
+	// A command buffer must only be used by one thread at a time
+	class EntityCommandBuffer
+	{
+	public:
+		EntityCommandBuffer() = default;
+		EntityCommandBuffer(const EntityCommandBuffer&) = delete;
+		EntityCommandBuffer& operator=(const EntityCommandBuffer&) = delete;
+		~EntityCommandBuffer();
+
+		// Returns a placeholder id, only valid for the commands of this buffer until it is applied
+		EntityId Create();
+		void Destroy(EntityId anId);
+
+		template<typename Type, typename ... Args>
+		void AddComponent(EntityId anId, Args&&... SomeArgs)
+		{
+			typename CommandList<Type>::Command& command = GetCommandList<Type>().myCommands.emplace_back();
+			command.myEntityId = anId;
+			command.myComponent.emplace(std::forward<Args>(SomeArgs)...);
+		}
+
+		template<typename Type>
+		void RemoveComponent(EntityId anId)
+		{
+			GetCommandList<Type>().myCommands.emplace_back().myEntityId = anId;
+		}
+
+		bool IsEmpty() const;
+
+		// Must be called from the thread that owns aWorld, while nothing else accesses it
+		void Apply(EntityWorld& aWorld);
+
+	private:
+		struct CommandListBase
+		{
+			virtual ~CommandListBase() {}
+			virtual bool IsEmpty() const = 0;
+			virtual uint GetComponentId(EntityWorld& aWorld) const = 0;
+			virtual void Apply(EntityWorld& aWorld, const std::vector<EntityId>& someCreatedEntities) = 0;
+		};
+
+		template<typename Type>
+		struct CommandList : public CommandListBase
+		{
+			// No component means a removal, commands of a type are applied in the order they were recorded
+			struct Command
+			{
+				EntityId myEntityId = UINT_MAX;
+				std::optional<Type> myComponent;
+			};
+
+			bool IsEmpty() const override { return myCommands.empty(); }
+			uint GetComponentId(EntityWorld& aWorld) const override { return aWorld.GetComponentId<Type>(); }
+
+			void Apply(EntityWorld& aWorld, const std::vector<EntityId>& someCreatedEntities) override
+			{
+				// The entity may have been destroyed since the command was recorded, by the world or by a buffer applied before this one
+				uint addedCount = 0;
+				for (Command& command : myCommands)
+				{
+					command.myEntityId = Resolve(command.myEntityId, someCreatedEntities);
+					if (!aWorld.Exists(command.myEntityId))
+						command.myEntityId = UINT_MAX;
+					else if (command.myComponent)
+						++addedCount;
+				}
+
+				ComponentContainer<Type>* container = aWorld.GetComponentContainer<Type>();
+				container->Reserve(container->GetSize() + addedCount);
+				for (Command& command : myCommands)
+				{
+					if (command.myEntityId == UINT_MAX)
+						continue;
+					if (command.myComponent)
+						aWorld.AddComponent<Type>(command.myEntityId, std::move(*command.myComponent));
+					else
+						container->RemoveComponent(command.myEntityId);
+				}
+				myCommands.clear();
+			}
+
+			std::vector<Command> myCommands;
+		};
+
+		static EntityId Resolve(EntityId anId, const std::vector<EntityId>& someCreatedEntities);
+
+		template<typename Type>
+		CommandList<Type>& GetCommandList()
+		{
+			// Buffers are filled from any thread, so the lists have their own type ids instead of the module's component ids
+			static const uint typeIndex = ourCommandListTypeCounter++;
+			if (typeIndex >= (uint)myCommandLists.size())
+				myCommandLists.resize(typeIndex + 1, nullptr);
+			if (!myCommandLists[typeIndex])
+				myCommandLists[typeIndex] = new CommandList<Type>();
+			return *static_cast<CommandList<Type>*>(myCommandLists[typeIndex]);
+		}
+
+		static inline std::atomic<uint> ourCommandListTypeCounter = 0;
+
+		uint myCreatedCount = 0;
+		std::vector<EntityId> myDestroyedEntities;
+		std::vector<CommandListBase*> myCommandLists;
+	};
+}
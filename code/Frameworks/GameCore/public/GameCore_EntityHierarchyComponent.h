@@ -0,0 +1,43 @@
+#pragma once
+
+#include "GameCore_EntityModule.h"
+
+namespace GameCore
+{
+	// Attaches an entity to a parent, its Entity3DTransformComponent is then relative to the parent
+	// Use EntityWorld::SetParent to build the hierarchy, the links are kept up to date when entities are destroyed
+	// World matrices are cached by the world, and only recomputed for the subtrees whose transform or parent changed
+	class EntityHierarchyComponent
+	{
+	public:
+		EntityId GetParent() const { return myParent; }
+		EntityId GetFirstChild() const { return myFirstChild; }
+		EntityId GetNextSibling() const { return myNextSibling; }
+		// Number of ancestors, roots have a depth of 0
+		uint GetDepth() const { return myDepth; }
+
+		// Up to date after the main update of the EntityModule
+		const glm::mat4& GetWorldMatrix() const { return myWorldMatrix; }
+
+		// See EntityWorld::Merge, the world matrix is recomputed in the destination world
+		void RemapEntities(const EntityRemap& aRemap)
+		{
+			myParent = aRemap(myParent);
+			myFirstChild = aRemap(myFirstChild);
+			myNextSibling = aRemap(myNextSibling);
+			myPreviousSibling = aRemap(myPreviousSibling);
+			myIsDirty = true;
+		}
+
+	private:
+		friend class EntityWorld;
+
+		EntityId myParent = UINT_MAX;
+		EntityId myFirstChild = UINT_MAX;
+		EntityId myNextSibling = UINT_MAX;
+		EntityId myPreviousSibling = UINT_MAX;
+		uint myDepth = 0;
+		bool myIsDirty = true;
+		glm::mat4 myWorldMatrix = glm::mat4(1.0f);
+	};
+}
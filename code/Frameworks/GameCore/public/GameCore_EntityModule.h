@@ -1,98 +1,591 @@
 #pragma once
 
 #include "GameCore_Module.h"
+#include "GameCore_Thread.h"
+#include "GameCore_ThreadAlgorithms.h"
+#include "GameCore_EntitySnapshot.h"
+#include "GameCore_SlotVector.h"
 
-#include <set>
-#include <map>
+#include <new>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+#include <tuple>
+#include <bit>
+#include <numeric>
+#include <span>
+#include <cstring>
+#include <typeinfo>
 
 namespace GameCore
 {
+	// An entity id packs the index of the entity slot in its low bits, and the generation of the slot in its high bits
+	// The generation is incremented each time the slot is freed, so handles to destroyed entities never alias new ones
 	typedef uint EntityId;
 
+	constexpr uint ourEntityIndexBits = 22;
+	constexpr uint ourEntityIndexMask = (1u << ourEntityIndexBits) - 1;
+	constexpr uint ourEntityGenerationMask = UINT_MAX >> ourEntityIndexBits;
+
+	inline uint GetEntityIndex(EntityId anId) { return anId & ourEntityIndexMask; }
+	inline uint GetEntityGeneration(EntityId anId) { return anId >> ourEntityIndexBits; }
+	inline EntityId MakeEntityId(uint anIndex, uint aGeneration) { return (aGeneration << ourEntityIndexBits) | anIndex; }
+
+	// Never used by alive entities, identifies the placeholder ids given by command buffers
+	constexpr uint ourDeferredEntityGeneration = ourEntityGenerationMask;
+
+	constexpr uint ourMaxComponentTypes = 128;
+
+	// Chunks of components are aligned on cache lines, and parallel batches start on cache line boundaries
+	constexpr uint ourCacheLineSize = 64;
+
+	// One bit per component type, telling which components an entity has
+	struct ComponentMask
+	{
+		inline void Set(uint aComponentId) { myWords[aComponentId / 64] |= 1ull << (aComponentId % 64); }
+		inline void Clear(uint aComponentId) { myWords[aComponentId / 64] &= ~(1ull << (aComponentId % 64)); }
+		inline bool Test(uint aComponentId) const { return (myWords[aComponentId / 64] & (1ull << (aComponentId % 64))) != 0; }
+		inline void Reset() { myWords.fill(0); }
+
+		bool Intersects(const ComponentMask& anOther) const
+		{
+			for (uint i = 0; i < (uint)myWords.size(); ++i)
+			{
+				if (myWords[i] & anOther.myWords[i])
+					return true;
+			}
+			return false;
+		}
+
+		// Calls aFunction(uint aComponentId) for each set bit
+		template<typename Function>
+		void ForEach(Function&& aFunction) const
+		{
+			for (uint i = 0; i < (uint)myWords.size(); ++i)
+			{
+				for (uint64 word = myWords[i]; word != 0; word &= word - 1)
+					aFunction(i * 64 + (uint)std::countr_zero(word));
+			}
+		}
+
+		std::array<uint64, ourMaxComponentTypes / 64> myWords = {};
+	};
+
+	// Translates the entity ids of a merged world to the ids they were given in the destination world, see EntityWorld::Merge
+	// Ids that were not alive in the merged world are translated to UINT_MAX
+	struct EntityRemap
+	{
+		EntityId operator()(EntityId anId) const
+		{
+			const uint index = GetEntityIndex(anId);
+			return anId != UINT_MAX && index < (uint)mySourceIds.size() && mySourceIds[index] == anId ? myDestinationIds[index] : UINT_MAX;
+		}
+
+		// Both indexed by the entity index in the merged world
+		std::vector<EntityId> mySourceIds;
+		std::vector<EntityId> myDestinationIds;
+	};
+
+	// Components holding entity ids patch them when their world is merged into another one
+	template<typename Type>
+	concept EntityRemappable = requires(Type& aComponent, const EntityRemap& aRemap) { aComponent.RemapEntities(aRemap); };
+
+	// Structural changes reported to the observers registered on a world
+	enum class ComponentEvent : uint
+	{
+		Add,
+		Remove,
+		Replace,
+		Count
+	};
+
 	class ComponentContainerBase
 	{
 	public:
 		// anElementSize is the size of one element in bytes
+		// anElementAlignment is the alignment required by one element in bytes
 		// aChunkSize is the number of elements in one contiguous chunk of data
-		ComponentContainerBase(uint anElementSize, uint aChunkSize)
+		ComponentContainerBase(uint anElementSize, uint anElementAlignment, uint aChunkSize)
 			: myElementSize(anElementSize)
+			, myChunkAlignment((std::max)(anElementAlignment, ourCacheLineSize))
 			, myChunkSize(aChunkSize)
+			, myBatchGranularity(ourCacheLineSize / std::gcd(anElementSize, ourCacheLineSize))
 		{}
 
 		virtual ~ComponentContainerBase()
 		{
 			for (char* chunk : myChunks)
-				delete[] chunk;
+				::operator delete[](chunk, std::align_val_t(myChunkAlignment));
+			for (uint* page : mySparsePages)
+				delete[] page;
 		}
 
-		virtual void OnEntityCreated(EntityId anId) = 0;
 		virtual void OnEntityDestroyed(EntityId anId) = 0;
+		// Removes all the components
+		virtual void Clear() = 0;
+
+		// See EntityWorld::SaveSnapshot, containers that can't be saved write and read nothing
+		virtual bool CanSnapshot() const { return false; }
+		virtual void WriteSnapshot(EntitySnapshotWriter& /*aWriter*/) const {}
+		// Replaces the content of the container, failures are reported by aReader
+		virtual void ReadSnapshot(EntitySnapshotReader& /*aReader*/) { Clear(); }
+
+		// Empty container of the same type, to receive the components of a merged world
+		virtual ComponentContainerBase* CreateEmpty() const = 0;
+		// Moves all the components to aDestination, created by CreateEmpty, under the remapped entity ids
+		// The entities must not have the component in aDestination yet, this container is left empty
+		virtual void MoveComponentsTo(ComponentContainerBase& aDestination, const EntityRemap& aRemap) = 0;
+
+		// Identifies the container in snapshots, only stable across builds made with the same compiler
+		inline const char* GetTypeName() const { return myTypeName; }
+
+		// Keeps the bit aComponentId of the entity masks up to date when components are added or removed
+		// someEntities maps entity indices to ids, for the containers that only know indices
+		void BindEntities(const std::vector<EntityId>* someEntities, std::vector<ComponentMask>* someEntityMasks, uint aComponentId)
+		{
+			myEntities = someEntities;
+			myEntityMasks = someEntityMasks;
+			myComponentId = aComponentId;
+		}
+
+		// Changes are only recorded for the observed events
+		void SetObservedEvent(ComponentEvent anEvent, bool anIsObserved)
+		{
+			if (anIsObserved)
+				myObservedEvents |= 1u << (uint)anEvent;
+			else
+				myObservedEvents &= ~(1u << (uint)anEvent);
+		}
+
+		// Moves the ids recorded for anEvent since the last call to someOutIds, in the order of the changes
+		void TakeEvents(ComponentEvent anEvent, std::vector<EntityId>& someOutIds)
+		{
+			someOutIds.clear();
+			someOutIds.swap(myEvents[(uint)anEvent]);
+		}
 
-	protected:
-		inline uint GetCapacity() const { return myChunkSize * (uint)myChunks.size(); }
 		inline uint GetSize() const { return mySize; }
+		// Incremented each time a component is added or removed
+		inline uint GetStructureVersion() const { return myStructureVersion; }
+		inline bool HasComponent(EntityId anId) const { return GetIndex(anId) != UINT_MAX; }
+		// True if anId is alive in the bound world, unbound containers accept any id
+		inline bool IsEntityAlive(EntityId anId) const
+		{
+			const uint entityIndex = GetEntityIndex(anId);
+			return !myEntities || (entityIndex < (uint)myEntities->size() && (*myEntities)[entityIndex] == anId);
+		}
+
+		// Entity owning the element at anIndex in the dense array
+		// Tags have no dense array, use ForEachEntityId to visit the entities of any container
+		inline EntityId GetEntityId(uint anIndex) const
+		{
+			Assert(anIndex < (uint)myDenseEntityIds.size(), "No dense element at this index, is the container a tag?");
+			return myDenseEntityIds[anIndex];
+		}
+
+		// Calls aFunction(EntityId) for each entity having the component
+		virtual void ForEachEntityId(const std::function<void(EntityId)>& aFunction) const
+		{
+			for (uint i = 0; i < mySize; ++i)
+				aFunction(myDenseEntityIds[i]);
+		}
+
+		// Components remember the tick during which they were last added or marked as changed
+		// The tick is advanced once per frame by the EntityModule
+		inline uint GetChangeTick() const { return myChangeTick; }
+		inline void SetChangeTick(uint aTick) { myChangeTick = aTick; }
+		inline void MarkChanged(EntityId anId)
+		{
+			const uint index = GetIndex(anId);
+			if (index != UINT_MAX)
+				myChangeTicks[index] = myChangeTick;
+		}
+		// True if the component was added or marked as changed during aTick or later
+		inline bool HasChangedSince(EntityId anId, uint aTick) const
+		{
+			const uint index = GetIndex(anId);
+			return index != UINT_MAX && myChangeTicks[index] >= aTick;
+		}
+
+		// Frees the chunks past the last component, the empty sparse pages and the spare capacity of the bookkeeping
+		// The dense array is always packed, so no component moves
+		virtual void ShrinkToFit()
+		{
+			const uint usedChunksCount = (mySize + myChunkSize - 1) / myChunkSize;
+			for (uint i = usedChunksCount; i < (uint)myChunks.size(); ++i)
+				::operator delete[](myChunks[i], std::align_val_t(myChunkAlignment));
+			myChunks.resize(usedChunksCount);
+			myChunks.shrink_to_fit();
+
+			for (uint page = 0; page < (uint)mySparsePages.size(); ++page)
+			{
+				if (mySparsePages[page] && mySparsePageCounts[page] == 0)
+				{
+					delete[] mySparsePages[page];
+					mySparsePages[page] = nullptr;
+				}
+			}
+			while (!mySparsePages.empty() && !mySparsePages.back())
+			{
+				mySparsePages.pop_back();
+				mySparsePageCounts.pop_back();
+			}
+			mySparsePages.shrink_to_fit();
+			mySparsePageCounts.shrink_to_fit();
+
+			myDenseEntityIds.shrink_to_fit();
+			myChangeTicks.shrink_to_fit();
+		}
+
+		// True when at least aMinUnusedChunks chunks are unused, and more chunks are unused than used
+		// Always false for tags, they have no chunks
+		inline bool HasUnusedChunks(uint aMinUnusedChunks) const
+		{
+			const uint usedChunksCount = (mySize + myChunkSize - 1) / myChunkSize;
+			if (usedChunksCount >= (uint)myChunks.size())
+				return false;
+			const uint unusedChunksCount = (uint)myChunks.size() - usedChunksCount;
+			return unusedChunksCount >= aMinUnusedChunks && unusedChunksCount > usedChunksCount;
+		}
 
 		void Reserve(uint anElementCount)
 		{
 			while (GetCapacity() < anElementCount)
-				myChunks.push_back(new char[myElementSize * myChunkSize]);
+				myChunks.push_back(static_cast<char*>(::operator new[](myElementSize * myChunkSize, std::align_val_t(myChunkAlignment))));
+			// Grown geometrically, PushBack reserves one more element each time
+			if (myDenseEntityIds.capacity() < anElementCount)
+			{
+				const size_t capacity = (std::max)((size_t)anElementCount, myDenseEntityIds.capacity() * 2);
+				myDenseEntityIds.reserve(capacity);
+				myChangeTicks.reserve(capacity);
+			}
 		}
 
-		void Resize(uint anElementCount)
+		// Splits the dense range [0, aCount) in batches of at least aMinBatchSize elements, starting on cache line boundaries
+		// aBatchFunction(uint aBegin, uint anEnd) is called for each batch, on the workers of aPool and on the calling thread
+		template<typename Function>
+		void DispatchBatches(Thread::WorkerPool& aPool, uint aCount, uint aMinBatchSize, Function&& aBatchFunction) const
 		{
-			if (mySize >= anElementCount)
+			if (aCount == 0)
+				return;
+
+			if (aPool.GetWorkersCount() == 0)
+			{
+				aBatchFunction(0u, aCount);
+				return;
+			}
+
+			const uint batchSize = Align(Thread::GetParallelGrainSize(aPool, aCount, aMinBatchSize), myBatchGranularity);
+			if (batchSize >= aCount)
+			{
+				aBatchFunction(0u, aCount);
 				return;
-			Reserve(anElementCount);
-			mySize = anElementCount;
+			}
+
+			// Whole batches are then split between the threads by the pool
+			const uint batchesCount = (aCount + batchSize - 1) / batchSize;
+			Thread::ParallelFor(aPool, 0u, batchesCount, [&aBatchFunction, batchSize, aCount](uint aFirstBatch, uint anEndBatch) {
+				aBatchFunction(aFirstBatch * batchSize, (std::min)(anEndBatch * batchSize, aCount));
+			});
+		}
+
+	protected:
+		// The sparse array mapping entity ids to dense indices is split in pages of this many entries, allocated on demand
+		static constexpr uint ourSparsePageSize = 4096;
+
+		inline uint GetCapacity() const { return myChunkSize * (uint)myChunks.size(); }
+
+		// The sparse array is addressed by entity index, the dense entity id is checked so stale generations are not found
+		inline uint GetIndex(EntityId anId) const
+		{
+			const uint entityIndex = GetEntityIndex(anId);
+			const uint page = entityIndex / ourSparsePageSize;
+			if (page >= (uint)mySparsePages.size() || !mySparsePages[page])
+				return UINT_MAX;
+			const uint index = mySparsePages[page][entityIndex % ourSparsePageSize];
+			if (index == UINT_MAX || myDenseEntityIds[index] != anId)
+				return UINT_MAX;
+			return index;
+		}
+
+		void SetIndex(EntityId anId, uint anIndex)
+		{
+			const uint entityIndex = GetEntityIndex(anId);
+			const uint page = entityIndex / ourSparsePageSize;
+			if (page >= (uint)mySparsePages.size())
+			{
+				mySparsePages.resize(page + 1, nullptr);
+				mySparsePageCounts.resize(page + 1, 0);
+			}
+			if (!mySparsePages[page])
+			{
+				mySparsePages[page] = new uint[ourSparsePageSize];
+				std::fill_n(mySparsePages[page], ourSparsePageSize, UINT_MAX);
+			}
+
+			uint& entry = mySparsePages[page][entityIndex % ourSparsePageSize];
+			if (entry == UINT_MAX && anIndex != UINT_MAX)
+				mySparsePageCounts[page]++;
+			else if (entry != UINT_MAX && anIndex == UINT_MAX)
+				mySparsePageCounts[page]--;
+			entry = anIndex;
+		}
+
+		// Adds a slot for anId at the end of the dense array, and returns its index
+		uint PushBack(EntityId anId)
+		{
+			RecordEvent(ComponentEvent::Add, anId);
+			Reserve(mySize + 1);
+			SetIndex(anId, mySize);
+			myDenseEntityIds.push_back(anId);
+			myChangeTicks.push_back(myChangeTick);
+			if (myEntityMasks)
+				(*myEntityMasks)[GetEntityIndex(anId)].Set(myComponentId);
+			myStructureVersion++;
+			return mySize++;
+		}
+
+		// Drops the bookkeeping of all the slots, destroying the elements is up to the caller
+		void ClearEntities()
+		{
+			for (EntityId entityId : myDenseEntityIds)
+				RecordEvent(ComponentEvent::Remove, entityId);
+			if (myEntityMasks)
+			{
+				for (EntityId entityId : myDenseEntityIds)
+					(*myEntityMasks)[GetEntityIndex(entityId)].Clear(myComponentId);
+			}
+			for (uint* page : mySparsePages)
+				delete[] page;
+			mySparsePages.clear();
+			mySparsePageCounts.clear();
+			myDenseEntityIds.clear();
+			myChangeTicks.clear();
+			myStructureVersion++;
+			mySize = 0;
+		}
+
+		void WriteSnapshotEntities(EntitySnapshotWriter& aWriter) const
+		{
+			aWriter.Write(mySize);
+			aWriter.WriteBytes(myDenseEntityIds.data(), mySize * sizeof(EntityId));
+			aWriter.WriteBytes(myChangeTicks.data(), mySize * sizeof(uint));
+		}
+
+		// Adds the slots of the snapshot to the empty container, the elements are left uninitialized
+		// Fails the reader if an entity is dead, stale or listed twice
+		bool ReadSnapshotEntities(EntitySnapshotReader& aReader)
+		{
+			const uint size = aReader.Read<uint>();
+			if ((size_t)size * (sizeof(EntityId) + sizeof(uint)) > aReader.GetRemainingSize())
+			{
+				aReader.SetFailed();
+				return false;
+			}
+
+			Reserve(size);
+			for (uint i = 0; i < size; ++i)
+			{
+				const EntityId entityId = aReader.Read<EntityId>();
+				if ((myEntityMasks && GetEntityIndex(entityId) >= (uint)myEntityMasks->size()) || !IsEntityAlive(entityId) || HasComponent(entityId))
+				{
+					aReader.SetFailed();
+					return false;
+				}
+				PushBack(entityId);
+			}
+			aReader.ReadBytes(myChangeTicks.data(), size * sizeof(uint));
+			return true;
 		}
 
-		inline void* Get(uint anElementIndex)
+		inline void RecordEvent(ComponentEvent anEvent, EntityId anId)
 		{
-			return myChunks[anElementIndex / myChunkSize] + (anElementIndex % myChunkSize) * myElementSize;
+			if (myObservedEvents & (1u << (uint)anEvent))
+				myEvents[(uint)anEvent].push_back(anId);
 		}
 
-		inline const void* Get(uint anElementIndex) const
+		// Moves the bookkeeping of the last slot to anIndex and drops the last slot
+		// Relocating the element itself is up to the caller
+		void SwapAndPop(uint anIndex)
 		{
-			return myChunks[anElementIndex / myChunkSize] + (anElementIndex % myChunkSize) * myElementSize;
+			RecordEvent(ComponentEvent::Remove, myDenseEntityIds[anIndex]);
+			const uint lastIndex = mySize - 1;
+			SetIndex(myDenseEntityIds[anIndex], UINT_MAX);
+			if (myEntityMasks)
+				(*myEntityMasks)[GetEntityIndex(myDenseEntityIds[anIndex])].Clear(myComponentId);
+			if (anIndex != lastIndex)
+			{
+				myDenseEntityIds[anIndex] = myDenseEntityIds[lastIndex];
+				myChangeTicks[anIndex] = myChangeTicks[lastIndex];
+				SetIndex(myDenseEntityIds[anIndex], anIndex);
+			}
+			myDenseEntityIds.pop_back();
+			myChangeTicks.pop_back();
+			myStructureVersion++;
+			mySize--;
 		}
 
 		uint myElementSize = 0;
+		uint myChunkAlignment = 0;
 		uint myChunkSize = 0;
+		const char* myTypeName = "";
+		// Number of elements spanning whole cache lines, parallel batches are multiples of it
+		uint myBatchGranularity = 1;
 		uint mySize = 0;
+		uint myStructureVersion = 0;
 		std::vector<char*> myChunks;
+
+		std::vector<uint*> mySparsePages;
+		// Number of entries in use in each page, empty pages are freed by ShrinkToFit
+		std::vector<uint> mySparsePageCounts;
+		std::vector<EntityId> myDenseEntityIds;
+
+		uint myChangeTick = 0;
+		std::vector<uint> myChangeTicks;
+
+		const std::vector<EntityId>* myEntities = nullptr;
+		std::vector<ComponentMask>* myEntityMasks = nullptr;
+		uint myComponentId = UINT_MAX;
+
+		uint myObservedEvents = 0;
+		std::array<std::vector<EntityId>, (uint)ComponentEvent::Count> myEvents;
 	};
 
-	template<typename Type, uint ChunkSize = 128>
-	class ComponentContainer : public ComponentContainerBase
+	enum class ComponentLayout
 	{
+		AoS, // Whole components stored one after the other
+		SoA, // One array per field in each chunk, see ComponentFields
+		Tag, // No storage, one bit per entity index, used by empty types
+	};
+
+	// Specialize to store a component type as structure of arrays, listing the fields to store separately:
+	// template<> struct ComponentFields<Particle> { static constexpr auto ourFields = std::make_tuple(&Particle::myPosition, &Particle::myVelocity); };
+	template<typename Type>
+	struct ComponentFields {};
+
+	template<typename Type>
+	constexpr ComponentLayout ourDefaultComponentLayout = requires { ComponentFields<Type>::ourFields; } ? ComponentLayout::SoA
+		: (std::is_empty_v<Type> ? ComponentLayout::Tag : ComponentLayout::AoS);
+
+	template<typename Type, ComponentLayout Layout = ourDefaultComponentLayout<Type>, uint ChunkSize = 128>
+	class ComponentContainer;
+
+	// Components are stored packed in the order they were added, and the last one is moved into the hole left by a removal
+	// Pointers to components are therefore only stable until the next component of the same type is removed
+	// The non-const GetComponent marks the component as changed, iterating, views and GetAt don't (use MarkChanged when writing through them)
+	template<typename Type, uint ChunkSize>
+	class ComponentContainer<Type, ComponentLayout::AoS, ChunkSize> : public ComponentContainerBase
+	{
+		static_assert((ChunkSize & (ChunkSize - 1)) == 0, "ChunkSize must be a power of 2");
+		static_assert(std::is_move_constructible_v<Type>, "Components are relocated on removal and must be move constructible");
+
 	public:
-		ComponentContainer() : ComponentContainerBase(sizeof(Type), ChunkSize) {}
+		ComponentContainer() : ComponentContainerBase(sizeof(Type), alignof(Type), ChunkSize)
+		{
+			myTypeName = typeid(Type).name();
+		}
 
 		~ComponentContainer() override
 		{
-			for (const auto it : myEntityIdToIndexMap)
-				reinterpret_cast<Type*>(Get(it.second))->~Type();
+			for (uint i = 0; i < mySize; ++i)
+				GetAt(i)->~Type();
 		}
 
-		inline bool HasComponent(EntityId anId)
+		void Clear() override
+		{
+			for (uint i = 0; i < mySize; ++i)
+				GetAt(i)->~Type();
+			ClearEntities();
+		}
+
+		// Serialization hooks are preferred when provided, otherwise trivially copyable components are saved chunk by chunk
+		bool CanSnapshot() const override { return ourCanSnapshot<Type>; }
+
+		void WriteSnapshot(EntitySnapshotWriter& aWriter) const override
+		{
+			if constexpr (ourCanSnapshot<Type>)
+			{
+				WriteSnapshotEntities(aWriter);
+				if constexpr (SnapshotSerializable<Type>)
+				{
+					for (uint i = 0; i < mySize; ++i)
+						GetAt(i)->Serialize(aWriter);
+				}
+				else
+				{
+					for (uint begin = 0; begin < mySize; begin += ChunkSize)
+						aWriter.WriteBytes(myChunks[begin / ChunkSize], (std::min)(ChunkSize, mySize - begin) * sizeof(Type));
+				}
+			}
+		}
+
+		void ReadSnapshot(EntitySnapshotReader& aReader) override
+		{
+			Clear();
+			if constexpr (ourCanSnapshot<Type>)
+			{
+				if (!ReadSnapshotEntities(aReader))
+				{
+					ClearEntities();
+					return;
+				}
+
+				if constexpr (SnapshotSerializable<Type>)
+				{
+					for (uint i = 0; i < mySize; ++i)
+						new(GetAt(i)) Type(aReader);
+				}
+				else
+				{
+					for (uint begin = 0; begin < mySize; begin += ChunkSize)
+						aReader.ReadBytes(myChunks[begin / ChunkSize], (std::min)(ChunkSize, mySize - begin) * sizeof(Type));
+				}
+
+				// Truncated data, the components are constructed but not worth keeping
+				if (aReader.HasFailed())
+					Clear();
+			}
+		}
+
+		ComponentContainerBase* CreateEmpty() const override { return new ComponentContainer(); }
+
+		void MoveComponentsTo(ComponentContainerBase& aDestination, const EntityRemap& aRemap) override
 		{
-			return myEntityIdToIndexMap.find(anId) != myEntityIdToIndexMap.end();
+			ComponentContainer& destination = static_cast<ComponentContainer&>(aDestination);
+			destination.Reserve(destination.mySize + mySize);
+			for (uint i = 0; i < mySize; ++i)
+			{
+				Type* component = GetAt(i);
+				if constexpr (EntityRemappable<Type>)
+					component->RemapEntities(aRemap);
+
+				const EntityId entityId = aRemap(GetEntityId(i));
+				if (entityId != UINT_MAX)
+					new(destination.GetAt(destination.PushBack(entityId))) Type(std::move(*component));
+			}
+			Clear();
 		}
 
 		inline Type* GetComponent(EntityId anId)
 		{
-			const auto it = myEntityIdToIndexMap.find(anId);
-			if (it == myEntityIdToIndexMap.end())
+			const uint index = GetIndex(anId);
+			if (index == UINT_MAX)
 				return nullptr;
-			return reinterpret_cast<Type*>(Get(it->second));
+			myChangeTicks[index] = myChangeTick;
+			return GetAt(index);
 		}
 
 		inline const Type* GetComponent(EntityId anId) const
 		{
-			const auto it = myEntityIdToIndexMap.find(anId);
-			if (it == myEntityIdToIndexMap.end())
-				return nullptr;
-			return reinterpret_cast<Type*>(Get(it->second));
+			const uint index = GetIndex(anId);
+			return index != UINT_MAX ? GetAt(index) : nullptr;
+		}
+
+		// Same as GetComponent, without marking the component as changed
+		inline Type* GetComponentUntracked(EntityId anId)
+		{
+			const uint index = GetIndex(anId);
+			return index != UINT_MAX ? GetAt(index) : nullptr;
 		}
 
 		template<typename ... Args>
@@ -101,140 +594,1133 @@ namespace GameCore
 			if (Type* component = GetComponent(anId))
 				return component;
 
-			uint index = UINT_MAX;
-			if (myFreeIndices.size() == 0)
-			{
-				index = (uint)myEntityIdToIndexMap.size();
-				Resize(index + 1);
-			}
-			else
+			Type* component = GetAt(PushBack(anId));
+			new(component) Type(std::forward<Args>(SomeArgs)...);
+			return component;
+		}
+
+		// Replaces the component of anId, or adds it if there is none
+		template<typename ... Args>
+		Type* ReplaceComponent(EntityId anId, Args&&... SomeArgs)
+		{
+			const uint index = GetIndex(anId);
+			if (index == UINT_MAX)
+				return AddComponent(anId, std::forward<Args>(SomeArgs)...);
+
+			// Built first, the arguments may refer to the component being replaced
+			Type replacement(std::forward<Args>(SomeArgs)...);
+			Type* component = GetAt(index);
+			component->~Type();
+			new(component) Type(std::move(replacement));
+			myChangeTicks[index] = myChangeTick;
+			RecordEvent(ComponentEvent::Replace, anId);
+			return component;
+		}
+
+		// Adds a copy of aComponent to each entity of someIds, entities already owning one keep theirs
+		void AddComponents(std::span<const EntityId> someIds, const Type& aComponent)
+		{
+			Reserve(mySize + (uint)someIds.size());
+			for (EntityId entityId : someIds)
 			{
-				index = *myFreeIndices.begin();
-				myFreeIndices.erase(index);
-			}
+				if (HasComponent(entityId))
+					continue;
 
-			void* ptr = Get(index);
-			new(ptr) Type(std::forward<Args>(SomeArgs)...);
-			myEntityIdToIndexMap[anId] = index;
-			return reinterpret_cast<Type*>(ptr);
+				Type* component = GetAt(PushBack(entityId));
+				if constexpr (std::is_trivially_copyable_v<Type>)
+					std::memcpy(static_cast<void*>(component), &aComponent, sizeof(Type));
+				else
+					new(component) Type(aComponent);
+			}
 		}
 
 		void RemoveComponent(EntityId anId)
 		{
-			auto it = myEntityIdToIndexMap.find(anId);
-			if (it != myEntityIdToIndexMap.end())
+			const uint index = GetIndex(anId);
+			if (index == UINT_MAX)
+				return;
+
+			Type* component = GetAt(index);
+			component->~Type();
+
+			const uint lastIndex = mySize - 1;
+			if (index != lastIndex)
 			{
-				reinterpret_cast<Type*>(Get(it->second))->~Type();
-				myFreeIndices.insert(it->second);
-				myEntityIdToIndexMap.erase(it);
+				Type* last = GetAt(lastIndex);
+				new(component) Type(std::move(*last));
+				last->~Type();
 			}
+
+			SwapAndPop(index);
 		}
 
-		void OnEntityCreated(EntityId /*anId*/) override {}
 		void OnEntityDestroyed(EntityId anId) override
 		{
 			RemoveComponent(anId);
 		}
 
-		struct Iterator
+		// Direct access to the dense array, anIndex must be lower than GetSize()
+		inline Type* GetAt(uint anIndex) { return reinterpret_cast<Type*>(myChunks[anIndex / ChunkSize]) + (anIndex % ChunkSize); }
+		inline const Type* GetAt(uint anIndex) const { return reinterpret_cast<const Type*>(myChunks[anIndex / ChunkSize]) + (anIndex % ChunkSize); }
+
+		// Calls aFunction(EntityId, Type*) for each component added or marked as changed during aTick or later
+		template<typename Function>
+		void ForEachChangedSince(uint aTick, Function&& aFunction)
+		{
+			for (uint i = 0; i < mySize; ++i)
+			{
+				if (myChangeTicks[i] >= aTick)
+					aFunction(GetEntityId(i), GetAt(i));
+			}
+		}
+
+		// Calls aFunction(EntityId, Type*) for each component, spread over the workers of aPool
+		// aFunction must not add or remove components of this type
+		template<typename Function>
+		void ForEachParallel(Thread::WorkerPool& aPool, Function&& aFunction, uint aMinBatchSize = 64)
 		{
-			using SubIterator = std::map<EntityId, uint>::iterator;
+			DispatchBatches(aPool, mySize, aMinBatchSize, [this, &aFunction](uint aBegin, uint anEnd) {
+				for (uint i = aBegin; i < anEnd; ++i)
+					aFunction(GetEntityId(i), GetAt(i));
+			});
+		}
 
-			Iterator(ComponentContainer& aContainer, SubIterator anIterator)
+		struct Iterator
+		{
+			Iterator(ComponentContainer& aContainer, uint anIndex)
 				: myContainer(aContainer)
-				, myIterator(anIterator)
+				, myIndex(anIndex)
 			{}
 
-			EntityId GetEntityId() const { return myIterator->first; }
-			Type* GetComponent() const { return myContainer.GetAt(myIterator->second); }
-			Type* operator*() const { return myContainer.GetAt(myIterator->second); }
-			Iterator& operator++() { myIterator++; return *this; }
+			EntityId GetEntityId() const { return myContainer.GetEntityId(myIndex); }
+			Type* GetComponent() const { return myContainer.GetAt(myIndex); }
+			Type* operator*() const { return myContainer.GetAt(myIndex); }
+			Iterator& operator++() { myIndex++; return *this; }
 
-			bool operator==(const Iterator& anOther) const { return myIterator == anOther.myIterator; }
-			bool operator!=(const Iterator& anOther) const { return myIterator != anOther.myIterator; }
+			bool operator==(const Iterator& anOther) const { return myIndex == anOther.myIndex; }
+			bool operator!=(const Iterator& anOther) const { return myIndex != anOther.myIndex; }
 
 		private:
 			ComponentContainer& myContainer;
-			SubIterator myIterator;
+			uint myIndex;
 		};
 
-		inline Iterator begin() { return Iterator(*this, myEntityIdToIndexMap.begin()); }
-		inline Iterator end() { return Iterator(*this, myEntityIdToIndexMap.end()); }
-
-	protected:
-		friend Iterator;
-		inline Type* GetAt(uint anIndex) { return reinterpret_cast<Type*>(Get(anIndex)); }
-
-	private:
-		std::map<EntityId, uint> myEntityIdToIndexMap;
-		std::set<uint> myFreeIndices;
+		inline Iterator begin() { return Iterator(*this, 0); }
+		inline Iterator end() { return Iterator(*this, mySize); }
 	};
 
-	class EntityModule : public Module
+	template<typename MemberPointer>
+	struct ComponentFieldType;
+	template<typename Class, typename Field>
+	struct ComponentFieldType<Field Class::*> { using Type = Field; };
+
+	// Each chunk holds one array per field: [field 0 x ChunkSize][field 1 x ChunkSize]...
+	// Field arrays start on cache lines, so the spans given by ForEachSpan can be fed directly to SIMD kernels
+	// Components are added as a whole and split into their fields, then only accessed field by field
+	template<typename Type, uint ChunkSize>
+	class ComponentContainer<Type, ComponentLayout::SoA, ChunkSize> : public ComponentContainerBase
 	{
-	DECLARE_GAMECORE_MODULE(EntityModule, "Entity")
+		static_assert((ChunkSize & (ChunkSize - 1)) == 0, "ChunkSize must be a power of 2");
+		static_assert(ChunkSize % ourCacheLineSize == 0, "ChunkSize must keep the field arrays on cache lines");
+
+		static constexpr auto ourFields = ComponentFields<Type>::ourFields;
+		static constexpr uint ourFieldsCount = (uint)std::tuple_size_v<std::remove_const_t<decltype(ourFields)>>;
+		using FieldIndices = std::make_index_sequence<ourFieldsCount>;
 
 	public:
-		EntityId Create();
-		void Destroy(EntityId anId);
-		bool Exists(EntityId anId) const { return anId < myNextEntityId&& myFreeEntityIds.find(anId) == myFreeEntityIds.end(); }
+		template<uint FieldIndex>
+		using FieldType = typename ComponentFieldType<std::remove_const_t<std::tuple_element_t<FieldIndex, std::remove_const_t<decltype(ourFields)>>>>::Type;
 
-		template<typename Type>
-		inline bool HasComponent(EntityId anId)
+		ComponentContainer() : ComponentContainerBase(GetFieldsSize(FieldIndices()), GetFieldsAlignment(FieldIndices()), ChunkSize)
 		{
-			return static_cast<ComponentContainer<Type>*>(myComponentContainers[GetComponentId<Type>()])->HasComponent(anId);
+			myTypeName = typeid(Type).name();
+			myBatchGranularity = GetFieldsBatchGranularity(FieldIndices());
 		}
 
-		template<typename Type>
-		inline Type* GetComponent(EntityId anId)
+		~ComponentContainer() override
 		{
-			return static_cast<ComponentContainer<Type>*>(myComponentContainers[GetComponentId<Type>()])->GetComponent(anId);
+			for (uint i = 0; i < mySize; ++i)
+				DestroyAt(i, FieldIndices());
 		}
 
-		template<typename Type>
-		inline const Type* GetComponent(EntityId anId) const
+		void Clear() override
 		{
-			return static_cast<const ComponentContainer<Type>*>(myComponentContainers[GetComponentId<Type>()])->GetComponent(anId);
+			for (uint i = 0; i < mySize; ++i)
+				DestroyAt(i, FieldIndices());
+			ClearEntities();
 		}
 
-		template<typename Type, typename ... Args>
-		inline Type* AddComponent(EntityId anId, Args&&... SomeArgs)
+		// Only when all the fields are trivially copyable, the field arrays are then saved chunk by chunk
+		bool CanSnapshot() const override { return ourCanSnapshotFields; }
+
+		void WriteSnapshot(EntitySnapshotWriter& aWriter) const override
 		{
-			return static_cast<ComponentContainer<Type>*>(myComponentContainers[GetComponentId<Type>()])->AddComponent(anId, std::forward<Args>(SomeArgs)...);
+			if constexpr (ourCanSnapshotFields)
+			{
+				WriteSnapshotEntities(aWriter);
+				for (uint begin = 0; begin < mySize; begin += ChunkSize)
+				{
+					for (uint field = 0; field < ourFieldsCount; ++field)
+						aWriter.WriteBytes(myChunks[begin / ChunkSize] + ourFieldOffsets[field], (std::min)(ChunkSize, mySize - begin) * ourFieldSizes[field]);
+				}
+			}
 		}
 
-		template<typename Type>
-		inline void RemoveComponent(EntityId anId)
+		void ReadSnapshot(EntitySnapshotReader& aReader) override
 		{
-			return static_cast<ComponentContainer<Type>*>(myComponentContainers[GetComponentId<Type>()])->RemoveComponent(anId);
+			Clear();
+			if constexpr (ourCanSnapshotFields)
+			{
+				if (!ReadSnapshotEntities(aReader))
+				{
+					ClearEntities();
+					return;
+				}
+
+				for (uint begin = 0; begin < mySize; begin += ChunkSize)
+				{
+					for (uint field = 0; field < ourFieldsCount; ++field)
+						aReader.ReadBytes(myChunks[begin / ChunkSize] + ourFieldOffsets[field], (std::min)(ChunkSize, mySize - begin) * ourFieldSizes[field]);
+				}
+
+				if (aReader.HasFailed())
+					Clear();
+			}
 		}
 
-		template<typename Type>
-		inline ComponentContainer<Type>* GetComponentContainer()
+		ComponentContainerBase* CreateEmpty() const override { return new ComponentContainer(); }
+
+		// Fields can't hold entity ids to remap, components referring to other entities must be AoS
+		void MoveComponentsTo(ComponentContainerBase& aDestination, const EntityRemap& aRemap) override
 		{
-			return static_cast<ComponentContainer<Type>*>(myComponentContainers[GetComponentId<Type>()]);
+			ComponentContainer& destination = static_cast<ComponentContainer&>(aDestination);
+			destination.Reserve(destination.mySize + mySize);
+			for (uint i = 0; i < mySize; ++i)
+			{
+				const EntityId entityId = aRemap(GetEntityId(i));
+				if (entityId != UINT_MAX)
+					MoveAt(i, destination, destination.PushBack(entityId), FieldIndices());
+			}
+			Clear();
 		}
 
-	protected:
-		void OnRegister() override;
-		void OnUnregister() override;
+		// Returns the index of the component in the dense arrays
+		template<typename ... Args>
+		uint AddComponent(EntityId anId, Args&&... SomeArgs)
+		{
+			uint index = GetIndex(anId);
+			if (index != UINT_MAX)
+				return index;
 
-		void OnUpdate(UpdateType aType) override;
+			Type component(std::forward<Args>(SomeArgs)...);
+			index = PushBack(anId);
+			ConstructAt(index, std::move(component), FieldIndices());
+			return index;
+		}
 
-	private:
-		template<typename Type>
-		inline uint GetComponentId()
+		// Replaces the component of anId, or adds it if there is none
+		template<typename ... Args>
+		uint ReplaceComponent(EntityId anId, Args&&... SomeArgs)
 		{
-			static uint id = myComponentIdCounter++;
-			if ((uint)myComponentContainers.size() == id)
-				myComponentContainers.push_back(new ComponentContainer<Type>());
-			return id;
+			const uint index = GetIndex(anId);
+			if (index == UINT_MAX)
+				return AddComponent(anId, std::forward<Args>(SomeArgs)...);
+
+			Type component(std::forward<Args>(SomeArgs)...);
+			DestroyAt(index, FieldIndices());
+			ConstructAt(index, std::move(component), FieldIndices());
+			myChangeTicks[index] = myChangeTick;
+			RecordEvent(ComponentEvent::Replace, anId);
+			return index;
 		}
 
-		EntityId myNextEntityId = 0;
-		std::set<EntityId> myFreeEntityIds;
+		// Adds a copy of aComponent to each entity of someIds, entities already owning one keep theirs
+		void AddComponents(std::span<const EntityId> someIds, const Type& aComponent)
+		{
+			Reserve(mySize + (uint)someIds.size());
+			for (EntityId entityId : someIds)
+			{
+				if (!HasComponent(entityId))
+					ConstructAt(PushBack(entityId), aComponent, FieldIndices());
+			}
+		}
 
-		uint myComponentIdCounter = 0;
-		std::vector<ComponentContainerBase*> myComponentContainers;
+		void RemoveComponent(EntityId anId)
+		{
+			const uint index = GetIndex(anId);
+			if (index == UINT_MAX)
+				return;
+
+			DestroyAt(index, FieldIndices());
+
+			const uint lastIndex = mySize - 1;
+			if (index != lastIndex)
+			{
+				RelocateAt(lastIndex, index, FieldIndices());
+				DestroyAt(lastIndex, FieldIndices());
+			}
+
+			SwapAndPop(index);
+		}
+
+		void OnEntityDestroyed(EntityId anId) override
+		{
+			RemoveComponent(anId);
+		}
+
+		// Marks the component as changed, like the non-const GetComponent of AoS containers
+		template<uint FieldIndex>
+		inline FieldType<FieldIndex>* GetField(EntityId anId)
+		{
+			const uint index = GetIndex(anId);
+			if (index == UINT_MAX)
+				return nullptr;
+			myChangeTicks[index] = myChangeTick;
+			return GetFieldAt<FieldIndex>(index);
+		}
+
+		template<uint FieldIndex>
+		inline const FieldType<FieldIndex>* GetField(EntityId anId) const
+		{
+			const uint index = GetIndex(anId);
+			return index != UINT_MAX ? GetFieldAt<FieldIndex>(index) : nullptr;
+		}
+
+		// Direct access to the dense arrays, anIndex must be lower than GetSize()
+		template<uint FieldIndex>
+		inline FieldType<FieldIndex>* GetFieldAt(uint anIndex)
+		{
+			return reinterpret_cast<FieldType<FieldIndex>*>(myChunks[anIndex / ChunkSize] + ourFieldOffsets[FieldIndex]) + (anIndex % ChunkSize);
+		}
+		template<uint FieldIndex>
+		inline const FieldType<FieldIndex>* GetFieldAt(uint anIndex) const
+		{
+			return reinterpret_cast<const FieldType<FieldIndex>*>(myChunks[anIndex / ChunkSize] + ourFieldOffsets[FieldIndex]) + (anIndex % ChunkSize);
+		}
+
+		// Calls aFunction(std::span<const EntityId>, std::span<Fields>...) for contiguous runs of components, at most one chunk long
+		template<typename Function>
+		void ForEachSpan(Function&& aFunction)
+		{
+			ForEachSpanInRange(0, mySize, aFunction, FieldIndices());
+		}
+
+		// Same as ForEachSpan, spread over the workers of aPool, spans start on cache lines
+		// aFunction must not add or remove components of this type
+		template<typename Function>
+		void ForEachSpanParallel(Thread::WorkerPool& aPool, Function&& aFunction, uint aMinBatchSize = ChunkSize)
+		{
+			DispatchBatches(aPool, mySize, aMinBatchSize, [this, &aFunction](uint aBegin, uint anEnd) {
+				ForEachSpanInRange(aBegin, anEnd, aFunction, FieldIndices());
+			});
+		}
+
+		// Calls aFunction(EntityId, uint anIndex) for each component added or marked as changed during aTick or later
+		template<typename Function>
+		void ForEachChangedSince(uint aTick, Function&& aFunction)
+		{
+			for (uint i = 0; i < mySize; ++i)
+			{
+				if (myChangeTicks[i] >= aTick)
+					aFunction(GetEntityId(i), i);
+			}
+		}
+
+	private:
+		template<size_t... Indices>
+		static constexpr uint GetFieldsSize(std::index_sequence<Indices...>) { return (0u + ... + (uint)sizeof(FieldType<Indices>)); }
+
+		template<size_t... Indices>
+		static constexpr uint GetFieldsAlignment(std::index_sequence<Indices...>) { return (std::max)({ 1u, (uint)alignof(FieldType<Indices>)... }); }
+
+		// Batches must start on a cache line in every field array
+		template<size_t... Indices>
+		static constexpr uint GetFieldsBatchGranularity(std::index_sequence<Indices...>)
+		{
+			return (std::max)({ 1u, (ourCacheLineSize / std::gcd((uint)sizeof(FieldType<Indices>), ourCacheLineSize))... });
+		}
+
+		template<size_t... Indices>
+		static constexpr std::array<uint, ourFieldsCount> GetFieldOffsets(std::index_sequence<Indices...>)
+		{
+			std::array<uint, ourFieldsCount> offsets = {};
+			uint offset = 0;
+			((offsets[Indices] = offset, offset += (uint)sizeof(FieldType<Indices>) * ChunkSize), ...);
+			return offsets;
+		}
+
+		template<size_t... Indices>
+		static constexpr std::array<uint, ourFieldsCount> GetFieldSizes(std::index_sequence<Indices...>) { return { (uint)sizeof(FieldType<Indices>)... }; }
+
+		template<size_t... Indices>
+		static constexpr bool CanSnapshotFields(std::index_sequence<Indices...>) { return (std::is_trivially_copyable_v<FieldType<Indices>> && ...); }
+
+		static constexpr std::array<uint, ourFieldsCount> ourFieldOffsets = GetFieldOffsets(FieldIndices());
+		static constexpr std::array<uint, ourFieldsCount> ourFieldSizes = GetFieldSizes(FieldIndices());
+		static constexpr bool ourCanSnapshotFields = CanSnapshotFields(FieldIndices());
+
+		template<typename Component, size_t... Indices>
+		void ConstructAt(uint anIndex, Component&& aComponent, std::index_sequence<Indices...>)
+		{
+			(ConstructFieldAt<Indices>(anIndex, std::forward<Component>(aComponent).*std::get<Indices>(ourFields)), ...);
+		}
+
+		template<uint FieldIndex, typename Field>
+		void ConstructFieldAt(uint anIndex, Field&& aField)
+		{
+			using Value = FieldType<FieldIndex>;
+			if constexpr (std::is_trivially_copyable_v<Value>)
+				std::memcpy(static_cast<void*>(GetFieldAt<FieldIndex>(anIndex)), &aField, sizeof(Value));
+			else
+				new(GetFieldAt<FieldIndex>(anIndex)) Value(std::forward<Field>(aField));
+		}
+
+		template<size_t... Indices>
+		void RelocateAt(uint aFromIndex, uint aToIndex, std::index_sequence<Indices...>)
+		{
+			(new(GetFieldAt<Indices>(aToIndex)) FieldType<Indices>(std::move(*GetFieldAt<Indices>(aFromIndex))), ...);
+		}
+
+		template<size_t... Indices>
+		void MoveAt(uint anIndex, ComponentContainer& aDestination, uint aDestinationIndex, std::index_sequence<Indices...>)
+		{
+			(new(aDestination.GetFieldAt<Indices>(aDestinationIndex)) FieldType<Indices>(std::move(*GetFieldAt<Indices>(anIndex))), ...);
+		}
+
+		template<size_t... Indices>
+		void DestroyAt(uint anIndex, std::index_sequence<Indices...>)
+		{
+			(std::destroy_at(GetFieldAt<Indices>(anIndex)), ...);
+		}
+
+		template<typename Function, size_t... Indices>
+		void ForEachSpanInRange(uint aBegin, uint anEnd, Function& aFunction, std::index_sequence<Indices...>)
+		{
+			for (uint begin = aBegin; begin < anEnd;)
+			{
+				const uint end = (std::min)(anEnd, (begin / ChunkSize + 1) * ChunkSize);
+				const uint count = end - begin;
+				aFunction(std::span<const EntityId>(myDenseEntityIds.data() + begin, count), std::span<FieldType<Indices>>(GetFieldAt<Indices>(begin), count)...);
+				begin = end;
+			}
+		}
+	};
+
+	// Tags are empty components: an entity has it or not, which is stored as one bit per entity index
+	// The generation of the ids is checked against the entities of the world, unbound containers only check the index
+	// GetComponent returns a shared const instance for tagged entities, so tags can be used like any other component
+	template<typename Type, uint ChunkSize>
+	class ComponentContainer<Type, ComponentLayout::Tag, ChunkSize> : public ComponentContainerBase
+	{
+	public:
+		ComponentContainer() : ComponentContainerBase(0, alignof(Type), ChunkSize)
+		{
+			myTypeName = typeid(Type).name();
+		}
+
+		inline const Type* GetComponent(EntityId anId) const { return HasComponent(anId) ? &ourTag : nullptr; }
+		inline const Type* GetComponentUntracked(EntityId anId) const { return GetComponent(anId); }
+
+		// Bits are cleared when entities are destroyed, so once bound to a world the slot tells whether the generation matches
+		inline bool HasComponent(EntityId anId) const
+		{
+			const uint entityIndex = GetEntityIndex(anId);
+			if (entityIndex / 64 >= (uint)myBits.size() || (myBits[entityIndex / 64] & (1ull << (entityIndex % 64))) == 0)
+				return false;
+			return !myEntities || (*myEntities)[entityIndex] == anId;
+		}
+
+		// The arguments are ignored, they are only accepted to share the interface of the other containers
+		// Null if anId is not alive
+		template<typename ... Args>
+		const Type* AddComponent(EntityId anId, Args&&...)
+		{
+			SetBit(anId, true);
+			return GetComponent(anId);
+		}
+
+		// Tags have no value to replace, only the event is recorded
+		template<typename ... Args>
+		const Type* ReplaceComponent(EntityId anId, Args&&...)
+		{
+			if (HasComponent(anId))
+				RecordEvent(ComponentEvent::Replace, anId);
+			else
+				SetBit(anId, true);
+			return GetComponent(anId);
+		}
+
+		void AddComponents(std::span<const EntityId> someIds, const Type&)
+		{
+			for (EntityId entityId : someIds)
+				SetBit(entityId, true);
+		}
+
+		void RemoveComponent(EntityId anId)
+		{
+			SetBit(anId, false);
+		}
+
+		void OnEntityDestroyed(EntityId anId) override
+		{
+			SetBit(anId, false);
+		}
+
+		// Nothing to reserve, hides the chunk allocation of the base
+		void Reserve(uint) {}
+
+		void Clear() override
+		{
+			ForEachEntityIndex([this](uint anEntityIndex) {
+				if (myEntityMasks)
+					(*myEntityMasks)[anEntityIndex].Clear(myComponentId);
+				if (myEntities)
+					RecordEvent(ComponentEvent::Remove, (*myEntities)[anEntityIndex]);
+			});
+			myBits.clear();
+			mySize = 0;
+			myStructureVersion++;
+		}
+
+		void ShrinkToFit() override
+		{
+			while (!myBits.empty() && myBits.back() == 0)
+				myBits.pop_back();
+			myBits.shrink_to_fit();
+		}
+
+		bool CanSnapshot() const override { return true; }
+
+		void WriteSnapshot(EntitySnapshotWriter& aWriter) const override
+		{
+			aWriter.Write((uint)myBits.size());
+			aWriter.WriteBytes(myBits.data(), myBits.size() * sizeof(uint64));
+		}
+
+		void ReadSnapshot(EntitySnapshotReader& aReader) override
+		{
+			Clear();
+			const uint wordsCount = aReader.Read<uint>();
+			if ((size_t)wordsCount * sizeof(uint64) > aReader.GetRemainingSize())
+			{
+				aReader.SetFailed();
+				return;
+			}
+
+			myBits.resize(wordsCount);
+			aReader.ReadBytes(myBits.data(), wordsCount * sizeof(uint64));
+
+			// Tagged entities must be alive, a free slot holds the index of the next free one
+			bool areEntitiesAlive = true;
+			ForEachEntityIndex([this, &areEntitiesAlive](uint anEntityIndex) {
+				if (myEntityMasks && anEntityIndex >= (uint)myEntityMasks->size())
+					areEntitiesAlive = false;
+				else if (myEntities && (anEntityIndex >= (uint)myEntities->size() || GetEntityIndex((*myEntities)[anEntityIndex]) != anEntityIndex))
+					areEntitiesAlive = false;
+			});
+			if (!areEntitiesAlive || aReader.HasFailed())
+			{
+				myBits.clear();
+				aReader.SetFailed();
+				return;
+			}
+
+			ForEachEntityIndex([this](uint anEntityIndex) {
+				if (myEntityMasks)
+					(*myEntityMasks)[anEntityIndex].Set(myComponentId);
+				if (myEntities)
+					RecordEvent(ComponentEvent::Add, (*myEntities)[anEntityIndex]);
+				mySize++;
+			});
+		}
+
+		void ForEachEntityId(const std::function<void(EntityId)>& aFunction) const override
+		{
+			Assert(myEntities != nullptr, "Tags need the entity ids of their world to be visited");
+			ForEachEntityIndex([this, &aFunction](uint anEntityIndex) {
+				aFunction((*myEntities)[anEntityIndex]);
+			});
+		}
+
+		ComponentContainerBase* CreateEmpty() const override { return new ComponentContainer(); }
+
+		void MoveComponentsTo(ComponentContainerBase& aDestination, const EntityRemap& aRemap) override
+		{
+			ComponentContainer& destination = static_cast<ComponentContainer&>(aDestination);
+			Assert(myEntities != nullptr, "Tags need the entity ids of their world to be moved");
+			ForEachEntityIndex([&](uint anEntityIndex) {
+				const EntityId entityId = aRemap((*myEntities)[anEntityIndex]);
+				if (entityId != UINT_MAX)
+					destination.SetBit(entityId, true);
+			});
+			Clear();
+		}
+
+		// One bit per entity index, words past the end are 0
+		inline const std::vector<uint64>& GetBits() const { return myBits; }
+		inline uint64 GetWord(uint aWordIndex) const { return aWordIndex < (uint)myBits.size() ? myBits[aWordIndex] : 0; }
+
+	private:
+		// Stale ids are ignored, their slot belongs to another entity
+		void SetBit(EntityId anId, bool aValue)
+		{
+			if (!IsEntityAlive(anId))
+				return;
+
+			const uint entityIndex = GetEntityIndex(anId);
+			const uint64 bit = 1ull << (entityIndex % 64);
+			if (entityIndex / 64 >= (uint)myBits.size())
+			{
+				if (!aValue)
+					return;
+				myBits.resize(entityIndex / 64 + 1, 0);
+			}
+
+			uint64& word = myBits[entityIndex / 64];
+			if (((word & bit) != 0) == aValue)
+				return;
+
+			word ^= bit;
+			RecordEvent(aValue ? ComponentEvent::Add : ComponentEvent::Remove, anId);
+			if (myEntityMasks)
+			{
+				if (aValue)
+					(*myEntityMasks)[entityIndex].Set(myComponentId);
+				else
+					(*myEntityMasks)[entityIndex].Clear(myComponentId);
+			}
+			if (aValue)
+				mySize++;
+			else
+				mySize--;
+			myStructureVersion++;
+		}
+
+		template<typename Function>
+		void ForEachEntityIndex(Function&& aFunction) const
+		{
+			for (uint i = 0; i < (uint)myBits.size(); ++i)
+			{
+				for (uint64 word = myBits[i]; word != 0; word &= word - 1)
+					aFunction(i * 64 + (uint)std::countr_zero(word));
+			}
+		}
+
+		static inline const Type ourTag{};
+		std::vector<uint64> myBits;
+	};
+
+	// Joins several component containers: the smallest one drives the iteration, the others are looked up for each of its entities
+	// Iterating yields a tuple of component pointers, for entities having all the requested components
+	template<typename... Types>
+	class EntityView
+	{
+		static_assert(((ourDefaultComponentLayout<Types> == ComponentLayout::AoS) && ...), "Views only join AoS components, iterate on the field spans of SoA containers");
+
+	public:
+		using Components = std::tuple<Types*...>;
+
+		EntityView(ComponentContainer<Types>*... someContainers)
+			: myContainers(someContainers...)
+		{
+			const ComponentContainerBase* containers[] = { someContainers... };
+			myDriver = containers[0];
+			for (const ComponentContainerBase* container : containers)
+			{
+				if (container->GetSize() < myDriver->GetSize())
+					myDriver = container;
+			}
+		}
+
+		// Calls aFunction(EntityId, Types*...) for each entity of the view
+		template<typename Function>
+		void ForEach(Function&& aFunction)
+		{
+			for (uint i = 0, size = myDriver->GetSize(); i < size; ++i)
+			{
+				const EntityId entityId = myDriver->GetEntityId(i);
+				Components components = GetComponents(entityId);
+				if (IsComplete(components))
+					std::apply([&](Types*... someComponents) { aFunction(entityId, someComponents...); }, components);
+			}
+		}
+
+		// Calls aFunction(EntityId, Types*...) for each entity of the view, spread over the workers of aPool
+		// aFunction must not add or remove components of the joined types
+		template<typename Function>
+		void ForEachParallel(Thread::WorkerPool& aPool, Function&& aFunction, uint aMinBatchSize = 64)
+		{
+			myDriver->DispatchBatches(aPool, myDriver->GetSize(), aMinBatchSize, [this, &aFunction](uint aBegin, uint anEnd) {
+				for (uint i = aBegin; i < anEnd; ++i)
+				{
+					const EntityId entityId = myDriver->GetEntityId(i);
+					Components components = GetComponents(entityId);
+					if (IsComplete(components))
+						std::apply([&](Types*... someComponents) { aFunction(entityId, someComponents...); }, components);
+				}
+			});
+		}
+
+		struct Iterator
+		{
+			Iterator(EntityView& aView, uint anIndex)
+				: myView(aView)
+				, myIndex(anIndex)
+			{
+				SkipIncomplete();
+			}
+
+			EntityId GetEntityId() const { return myView.myDriver->GetEntityId(myIndex); }
+			const Components& operator*() const { return myComponents; }
+			Iterator& operator++() { myIndex++; SkipIncomplete(); return *this; }
+
+			bool operator==(const Iterator& anOther) const { return myIndex == anOther.myIndex; }
+			bool operator!=(const Iterator& anOther) const { return myIndex != anOther.myIndex; }
+
+		private:
+			void SkipIncomplete()
+			{
+				for (const uint size = myView.myDriver->GetSize(); myIndex < size; ++myIndex)
+				{
+					myComponents = myView.GetComponents(GetEntityId());
+					if (IsComplete(myComponents))
+						return;
+				}
+			}
+
+			EntityView& myView;
+			uint myIndex;
+			Components myComponents;
+		};
+
+		inline Iterator begin() { return Iterator(*this, 0); }
+		inline Iterator end() { return Iterator(*this, myDriver->GetSize()); }
+
+	private:
+		inline Components GetComponents(EntityId anId) const
+		{
+			return Components(std::get<ComponentContainer<Types>*>(myContainers)->GetComponentUntracked(anId)...);
+		}
+
+		static inline bool IsComplete(const Components& someComponents)
+		{
+			return ((std::get<Types*>(someComponents) != nullptr) && ...);
+		}
+
+		std::tuple<ComponentContainer<Types>*...> myContainers;
+		const ComponentContainerBase* myDriver = nullptr;
+	};
+
+	class EntityCachedViewBase
+	{
+	public:
+		virtual ~EntityCachedViewBase() {}
+	};
+
+	// Keeps the result of an EntityView, and only joins the containers again when one of them was structurally modified
+	// Component pointers stay valid as long as no component of the joined types is added or removed
+	template<typename... Types>
+	class EntityCachedView : public EntityCachedViewBase
+	{
+	public:
+		using Components = std::tuple<Types*...>;
+
+		EntityCachedView(ComponentContainer<Types>*... someContainers)
+			: myContainers(someContainers...)
+		{
+			myVersions.fill(UINT_MAX);
+		}
+
+		void Refresh()
+		{
+			const std::array<uint, sizeof...(Types)> versions = { std::get<ComponentContainer<Types>*>(myContainers)->GetStructureVersion()... };
+			if (versions == myVersions)
+				return;
+			myVersions = versions;
+
+			myEntityIds.clear();
+			myComponents.clear();
+			EntityView<Types...>(std::get<ComponentContainer<Types>*>(myContainers)...).ForEach([this](EntityId anId, Types*... someComponents) {
+				myEntityIds.push_back(anId);
+				myComponents.emplace_back(someComponents...);
+			});
+		}
+
+		inline uint GetSize() const { return (uint)myComponents.size(); }
+		inline EntityId GetEntityId(uint anIndex) const { return myEntityIds[anIndex]; }
+		inline const Components& GetComponents(uint anIndex) const { return myComponents[anIndex]; }
+
+		inline typename std::vector<Components>::const_iterator begin() const { return myComponents.begin(); }
+		inline typename std::vector<Components>::const_iterator end() const { return myComponents.end(); }
+
+	private:
+		std::tuple<ComponentContainer<Types>*...> myContainers;
+		std::array<uint, sizeof...(Types)> myVersions;
+
+		std::vector<EntityId> myEntityIds;
+		std::vector<Components> myComponents;
+	};
+
+	typedef std::function<void(std::span<const EntityId>)> ComponentObserverFunction;
+	// Receives the entities due this frame, and for each one the time elapsed since its last update
+	typedef std::function<void(std::span<const EntityId>, std::span<const float>)> EntityBucketedSystemFunction;
+
+	// Tag filters of EntityWorld::ForEachTagged
+	template<typename... Tags> struct With {};
+	template<typename... Tags> struct Without {};
+
+	template<typename... Types> struct Reads;
+	template<typename... Types> struct Writes;
+	struct EntityUpdateRates;
+	class EntitySystemScheduler;
+	struct EntityScheduleTrace;
+	class EntityCommandBuffer;
+
+	// Entities and their components, independent from the other worlds
+	// The EntityModule is the main world, other worlds can be filled on any thread (one thread at a time) and merged into it
+	class EntityWorld
+	{
+	public:
+		EntityWorld() = default;
+		EntityWorld(const EntityWorld&) = delete;
+		EntityWorld& operator=(const EntityWorld&) = delete;
+		virtual ~EntityWorld();
+
+		EntityId Create();
+		// Fills someOutIds with new entities
+		void CreateMany(std::span<EntityId> someOutIds);
+		void Destroy(EntityId anId);
+		bool Exists(EntityId anId) const { return GetEntityIndex(anId) < (uint)myEntities.size() && myEntities[GetEntityIndex(anId)] == anId; }
+
+		// Moves all the entities and components of aSource into this world, aSource is left empty
+		// The entities get new ids, the returned remap translates the ids of aSource to the new ones
+		// Components referring to other entities must provide void RemapEntities(const EntityRemap&), see EntityRemappable
+		EntityRemap Merge(EntityWorld& aSource);
+
+		// Components owned by the entity, one bit per component id
+		const ComponentMask& GetComponentMask(EntityId anId) const { return myEntityMasks[GetEntityIndex(anId)]; }
+
+		template<typename Type>
+		inline bool HasComponent(EntityId anId)
+		{
+			return Exists(anId) && myEntityMasks[GetEntityIndex(anId)].Test(GetComponentId<Type>());
+		}
+
+		// Write access, marks the component as changed: only use it to modify the component
+		// Tags have nothing to modify, a const pointer is returned for them
+		template<typename Type>
+		inline auto* GetComponent(EntityId anId)
+		{
+			return GetComponentContainer<Type>()->GetComponent(anId);
+		}
+
+		// Doesn't mark the component as changed, read-only systems must use it (through a const EntityWorld&)
+		template<typename Type>
+		inline const Type* GetComponent(EntityId anId) const
+		{
+			const ComponentContainer<Type>* container = GetComponentContainer<Type>();
+			return container ? container->GetComponent(anId) : nullptr;
+		}
+
+		// Same as the const GetComponent, for callers holding a non-const world
+		template<typename Type>
+		inline const Type* ReadComponent(EntityId anId) const
+		{
+			return GetComponent<Type>(anId);
+		}
+
+		// For components modified through ReadComponent, views or iteration
+		template<typename Type>
+		inline void MarkChanged(EntityId anId)
+		{
+			const uint id = GetComponentTypeId<Type>();
+			if (id < (uint)myComponentContainers.size() && myComponentContainers[id])
+				myComponentContainers[id]->MarkChanged(anId);
+		}
+
+		// Returns the component, or its dense index for SoA components
+		template<typename Type, typename ... Args>
+		inline auto AddComponent(EntityId anId, Args&&... SomeArgs)
+		{
+			Assert(Exists(anId), "Adding a component to an entity that doesn't exist!");
+			return GetComponentContainer<Type>()->AddComponent(anId, std::forward<Args>(SomeArgs)...);
+		}
+
+		// Adds a copy of aComponent to each entity of someIds
+		template<typename Type>
+		inline void AddComponents(std::span<const EntityId> someIds, const Type& aComponent)
+		{
+			GetComponentContainer<Type>()->AddComponents(someIds, aComponent);
+		}
+
+		// Replaces the component, or adds it if the entity has none
+		template<typename Type, typename ... Args>
+		inline auto ReplaceComponent(EntityId anId, Args&&... SomeArgs)
+		{
+			Assert(Exists(anId), "Replacing a component of an entity that doesn't exist!");
+			return GetComponentContainer<Type>()->ReplaceComponent(anId, std::forward<Args>(SomeArgs)...);
+		}
+
+		template<typename Type>
+		inline void RemoveComponent(EntityId anId)
+		{
+			return GetComponentContainer<Type>()->RemoveComponent(anId);
+		}
+
+		template<typename Type>
+		inline ComponentContainer<Type>* GetComponentContainer()
+		{
+			return static_cast<ComponentContainer<Type>*>(myComponentContainers[GetComponentId<Type>()]);
+		}
+
+		// Null if the world never used the component type, never creates the container
+		template<typename Type>
+		inline const ComponentContainer<Type>* GetComponentContainer() const
+		{
+			const uint id = GetComponentTypeId<Type>();
+			return id < (uint)myComponentContainers.size() ? static_cast<const ComponentContainer<Type>*>(myComponentContainers[id]) : nullptr;
+		}
+
+		// Null if the world never used the component type
+		inline ComponentContainerBase* GetComponentContainer(uint aComponentId)
+		{
+			return aComponentId < (uint)myComponentContainers.size() ? myComponentContainers[aComponentId] : nullptr;
+		}
+
+		template<typename... Types>
+		inline EntityView<Types...> View()
+		{
+			return EntityView<Types...>(GetComponentContainer<Types>()...);
+		}
+
+		// The returned view is owned by the world and up to date until the next structural change on one of Types
+		template<typename... Types>
+		inline const EntityCachedView<Types...>& CachedView()
+		{
+			EntityCachedView<Types...>* view = static_cast<EntityCachedView<Types...>*>(myCachedViews[GetCachedViewId<Types...>()]);
+			view->Refresh();
+			return *view;
+		}
+
+		// Calls aFunction(EntityId, Types*...) for each entity having all the With tags, none of the Without tags and all the Types components
+		// Tags are filtered 64 entities at a time, components are only looked up for the entities passing the filter
+		// ie: ForEachTagged<Entity3DTransformComponent>(With<Enemy, Visible>(), Without<Static>(), [](EntityId anId, Entity3DTransformComponent* aTransform) {})
+		template<typename... Types, typename... WithTags, typename... WithoutTags, typename Function>
+		void ForEachTagged(With<WithTags...>, Without<WithoutTags...>, Function&& aFunction)
+		{
+			static_assert(sizeof...(WithTags) > 0, "At least one tag is needed to drive the iteration");
+			static_assert(((ourDefaultComponentLayout<WithTags> == ComponentLayout::Tag) && ...) && ((ourDefaultComponentLayout<WithoutTags> == ComponentLayout::Tag) && ...), "Only tags can filter");
+
+			const std::tuple<ComponentContainer<WithTags>*...> withTags(GetComponentContainer<WithTags>()...);
+			const std::tuple<ComponentContainer<WithoutTags>*...> withoutTags(GetComponentContainer<WithoutTags>()...);
+			const std::tuple<ComponentContainer<Types>*...> containers(GetComponentContainer<Types>()...);
+
+			const uint wordsCount = (std::min)({ (uint)GetComponentContainer<WithTags>()->GetBits().size()... });
+			for (uint i = 0; i < wordsCount; ++i)
+			{
+				uint64 word = (std::get<ComponentContainer<WithTags>*>(withTags)->GetWord(i) & ...);
+				((word &= ~std::get<ComponentContainer<WithoutTags>*>(withoutTags)->GetWord(i)), ...);
+
+				for (; word != 0; word &= word - 1)
+				{
+					const EntityId entityId = myEntities[i * 64 + (uint)std::countr_zero(word)];
+					if constexpr (sizeof...(Types) == 0)
+					{
+						aFunction(entityId);
+					}
+					else
+					{
+						const std::tuple<Types*...> components(std::get<ComponentContainer<Types>*>(containers)->GetComponentUntracked(entityId)...);
+						if ((std::get<Types*>(components) && ...))
+							aFunction(entityId, std::get<Types*>(components)...);
+					}
+				}
+			}
+		}
+
+		template<typename... Types, typename... WithTags, typename Function>
+		void ForEachTagged(With<WithTags...> someTags, Function&& aFunction)
+		{
+			ForEachTagged<Types...>(someTags, Without<>(), std::forward<Function>(aFunction));
+		}
+
+		template<typename... Types>
+		inline ComponentMask MakeComponentMask()
+		{
+			ComponentMask mask;
+			(mask.Set(GetComponentId<Types>()), ...);
+			return mask;
+		}
+
+		// Advanced at the beginning of each frame, see ComponentContainerBase::HasChangedSince
+		uint GetChangeTick() const { return myChangeTick; }
+		void AdvanceChangeTick();
+
+		// Moves aChild under aParent, or makes it a root if aParent is UINT_MAX, see EntityHierarchyComponent
+		void SetParent(EntityId aChild, EntityId aParent);
+		// World matrix of the entity, combining the transforms of its ancestors if it is part of a hierarchy
+		glm::mat4 GetWorldMatrix(EntityId anId) const;
+		// Recomputes the world matrices of the subtrees whose transform or parent changed, parents before children
+		void UpdateHierarchy();
+
+		// Versioned binary dump of the entities and of the components that can be saved, see SnapshotSerializable
+		// Empty containers are not saved
+		// Appended to someOutData
+		void SaveSnapshot(std::vector<char>& someOutData) const;
+		// Replaces all the entities and components, components that can't be saved are dropped
+		// Containers are matched by type name, so the component types of the snapshot must have been used by the world before
+		// Returns false if the snapshot is invalid or has components of unknown types, which are skipped
+		bool RestoreSnapshot(const char* someData, size_t aSize);
+
+		// aFunction(std::span<const EntityId>) receives the entities whose Type component was added, removed or replaced since the last notification
+		// Batches are sent by NotifyObservers, called by the EntityModule during the main update once the systems, command buffers and hierarchy are done
+		// Removed batches are sent first, then Added and Replaced ones, each one sorted and without duplicates
+		// Added and Replaced only list the entities that still have the component, Removed only the ones that don't have it anymore
+		template<typename Type>
+		inline uint AddObserver(ComponentEvent anEvent, ComponentObserverFunction aFunction)
+		{
+			return AddObserver(GetComponentId<Type>(), anEvent, std::move(aFunction));
+		}
+		uint AddObserver(uint aComponentId, ComponentEvent anEvent, ComponentObserverFunction aFunction);
+		void RemoveObserver(uint anObserverId);
+		// Changes made by the observers are sent with the next notification
+		void NotifyObservers();
+
+		// Releases the memory the containers kept from their peak size
+		void ShrinkToFit();
+		// Shrinks the containers with at least SetAutoShrinkThreshold unused chunks, and more unused chunks than used ones
+		// Called by the EntityModule at the end of the main update, 0 disables it
+		void ShrinkUnusedMemory();
+		void SetAutoShrinkThreshold(uint aMinUnusedChunks) { myAutoShrinkThreshold = aMinUnusedChunks; }
+
+		// Component ids are shared by all the worlds, each world creates its containers on first use
+		template<typename Type>
+		inline uint GetComponentId()
+		{
+			const uint id = GetComponentTypeId<Type>();
+			if (id >= (uint)myComponentContainers.size() || !myComponentContainers[id])
+				AddComponentContainer(id, new ComponentContainer<Type>());
+			return id;
+		}
+
+	protected:
+		// Deletes all the entities, components, views and observers
+		void Reset();
+
+		// While locked, creating a container asserts, see EntityModule::AddSystem
+		void SetComponentContainersLocked(bool aLocked) { myComponentContainersAreLocked = aLocked; }
+
+	private:
+		struct ComponentObserverEntry
+		{
+			void Clear() { myFunction = nullptr; }
+			bool IsSet() const { return myFunction != nullptr; }
+
+			uint myComponentId = UINT_MAX;
+			ComponentEvent myEvent = ComponentEvent::Add;
+			ComponentObserverFunction myFunction = nullptr;
+		};
+
+		template<typename Type>
+		static inline uint GetComponentTypeId()
+		{
+			static const uint id = ourComponentIdCounter++;
+			return id;
+		}
+
+		void AddComponentContainer(uint aComponentId, ComponentContainerBase* aContainer);
+		void UpdateObservedEvents(uint aComponentId);
+
+		void DetachFromHierarchy(EntityId anId);
+		void UpdateHierarchyDepths(EntityId aRoot, uint aDepth);
+
+		template<typename... Types>
+		inline uint GetCachedViewId()
+		{
+			static const uint id = ourCachedViewIdCounter++;
+			if (id >= (uint)myCachedViews.size())
+				myCachedViews.resize(id + 1, nullptr);
+			if (!myCachedViews[id])
+				myCachedViews[id] = new EntityCachedView<Types...>(GetComponentContainer<Types>()...);
+			return id;
+		}
+
+		static inline std::atomic<uint> ourComponentIdCounter = 0;
+		static inline std::atomic<uint> ourCachedViewIdCounter = 0;
+
+		// For alive entities, the slot holds the entity id
+		// For free slots, it holds the index of the next free slot and the generation the slot will have once reused
+		// Free slots are reused in FIFO order to delay generation wrap-around as much as possible
+		std::vector<EntityId> myEntities;
+		uint myFreeHead = ourEntityIndexMask;
+		uint myFreeTail = ourEntityIndexMask;
+		uint myFreeCount = 0;
+
+		uint myChangeTick = 0;
+		uint myHierarchyUpdateTick = 0;
+		uint myAutoShrinkThreshold = 4;
+
+		SlotVector<ComponentObserverEntry> myObservers;
+
+		// Indexed by entity index, so destroying an entity only visits the containers it has components in
+		std::vector<ComponentMask> myEntityMasks;
+
+		// Indexed by component id, null for the types this world never used
+		std::vector<ComponentContainerBase*> myComponentContainers;
+		std::vector<EntityCachedViewBase*> myCachedViews;
+		bool myComponentContainersAreLocked = false;
+	};
+
+	class EntityModule : public Module, public EntityWorld
+	{
+	DECLARE_GAMECORE_MODULE(EntityModule, "Entity")
+
+	public:
+		// Systems are run each frame during the main update, on the workers of the module
+		// A system must only access the components it declared, and must not add or remove components
+		// The containers of the declared components are created here, the workers never create containers
+		// Components that are only read must be accessed through a const EntityWorld& or const containers, which don't mark them as changed
+		template<typename... ReadTypes, typename... WriteTypes>
+		inline uint AddSystem(const std::string& aName, Reads<ReadTypes...>, Writes<WriteTypes...>, std::function<void()> aFunction)
+		{
+			return AddSystem(aName, MakeComponentMask<ReadTypes...>(), MakeComponentMask<WriteTypes...>(), std::move(aFunction));
+		}
+		uint AddSystem(const std::string& aName, const ComponentMask& someReads, const ComponentMask& someWrites, std::function<void()> aFunction);
+
+		// System updating the entities having a Type component at a rate depending on their distance to the camera, see EntityUpdateRates
+		// The position of the entities is read from their Entity3DTransformComponent (or their world matrix in a hierarchy), entities without one are in the first bucket
+		template<typename Type, typename... ReadTypes, typename... WriteTypes>
+		inline uint AddBucketedSystem(const std::string& aName, Reads<ReadTypes...>, Writes<WriteTypes...>, const EntityUpdateRates& someRates, EntityBucketedSystemFunction aFunction)
+		{
+			return AddBucketedSystem(aName, MakeComponentMask<Type, ReadTypes...>(), MakeComponentMask<WriteTypes...>(), GetComponentId<Type>(), someRates, std::move(aFunction));
+		}
+		uint AddBucketedSystem(const std::string& aName, const ComponentMask& someReads, const ComponentMask& someWrites, uint aComponentId, const EntityUpdateRates& someRates, EntityBucketedSystemFunction aFunction);
+		void RemoveSystem(uint aSystemId);
+
+		const EntityScheduleTrace& GetLastScheduleTrace() const;
+
+		Thread::WorkerPool& GetWorkerPool() { return myWorkerPool; }
+
+		// Position of the first camera, distances of the bucketed systems are measured from it
+		const glm::vec3& GetUpdateRateOrigin() const { return myUpdateRateOrigin; }
+
+		// Command buffer of the calling thread, applied by FlushCommandBuffers
+		// The buffers are flushed during the main update, once the systems are done
+		EntityCommandBuffer& GetCommandBuffer();
+		void FlushCommandBuffers();
+
+	protected:
+		void OnRegister() override;
+		void OnUnregister() override;
+
+		void OnUpdate(UpdateType aType) override;
+
+	private:
+		Thread::WorkerPool myWorkerPool;
+		EntitySystemScheduler* mySystemScheduler = nullptr;
+		glm::vec3 myUpdateRateOrigin = glm::vec3(0.0f);
+
+		std::mutex myCommandBuffersMutex;
+		std::vector<std::pair<std::thread::id, EntityCommandBuffer*>> myCommandBuffers;
 	};
 }
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "GameCore_EntityModule.h"
+
+namespace GameCore
+{
+	// Set of component values copied to each instance, ie: EntityPrefab<Transform, Velocity> prefab(transform, velocity)
+	template<typename... Types>
+	class EntityPrefab
+	{
+	public:
+		EntityPrefab() = default;
+		EntityPrefab(const Types&... someComponents) : myComponents(someComponents...) {}
+
+		template<typename Type>
+		inline Type& Get() { return std::get<Type>(myComponents); }
+		template<typename Type>
+		inline const Type& Get() const { return std::get<Type>(myComponents); }
+
+		// Creates someOutIds.size() entities, each container is grown once for all of them
+		void Instantiate(EntityWorld& aWorld, std::span<EntityId> someOutIds) const
+		{
+			aWorld.CreateMany(someOutIds);
+			(aWorld.AddComponents<Types>(someOutIds, std::get<Types>(myComponents)), ...);
+		}
+
+		EntityId Instantiate(EntityWorld& aWorld) const
+		{
+			EntityId entityId;
+			Instantiate(aWorld, std::span<EntityId>(&entityId, 1));
+			return entityId;
+		}
+
+	private:
+		std::tuple<Types...> myComponents;
+	};
+}
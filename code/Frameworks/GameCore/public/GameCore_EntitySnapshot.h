@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstring>
+#include <type_traits>
+
+namespace GameCore
+{
+	// Bumped each time the layout of the snapshots changes, older snapshots are rejected
+	constexpr uint ourEntitySnapshotVersion = 1;
+	constexpr uint ourEntitySnapshotMagic = 0x53534345; // "ECSS"
+
+	class EntitySnapshotWriter
+	{
+	public:
+		EntitySnapshotWriter(std::vector<char>& someOutData) : myData(someOutData) {}
+
+		void WriteBytes(const void* someBytes, size_t aSize)
+		{
+			const size_t offset = myData.size();
+			myData.resize(offset + aSize);
+			if (aSize > 0)
+				std::memcpy(myData.data() + offset, someBytes, aSize);
+		}
+
+		template<typename Type>
+		void Write(const Type& aValue)
+		{
+			static_assert(std::is_trivially_copyable_v<Type>, "Only trivially copyable values can be written as is");
+			WriteBytes(&aValue, sizeof(Type));
+		}
+
+		void Write(const std::string& aString)
+		{
+			Write((uint)aString.size());
+			WriteBytes(aString.data(), aString.size());
+		}
+
+		// Offset of the next byte written, to patch values written earlier
+		size_t GetOffset() const { return myData.size(); }
+		char* GetData(size_t anOffset) { return myData.data() + anOffset; }
+
+	private:
+		std::vector<char>& myData;
+	};
+
+	// Reading past the end zero-fills the values and marks the reader as failed, so callers can check once at the end
+	class EntitySnapshotReader
+	{
+	public:
+		EntitySnapshotReader(const char* someData, size_t aSize) : myCursor(someData), myEnd(someData + aSize) {}
+
+		bool ReadBytes(void* someOutBytes, size_t aSize)
+		{
+			if (aSize > GetRemainingSize())
+			{
+				std::memset(someOutBytes, 0, aSize);
+				myCursor = myEnd;
+				myHasFailed = true;
+				return false;
+			}
+			if (aSize > 0)
+				std::memcpy(someOutBytes, myCursor, aSize);
+			myCursor += aSize;
+			return true;
+		}
+
+		template<typename Type>
+		Type Read()
+		{
+			static_assert(std::is_trivially_copyable_v<Type>, "Only trivially copyable values can be read as is");
+			Type value;
+			ReadBytes(&value, sizeof(Type));
+			return value;
+		}
+
+		std::string ReadString()
+		{
+			const uint size = Read<uint>();
+			if (size > GetRemainingSize())
+			{
+				myCursor = myEnd;
+				myHasFailed = true;
+				return std::string();
+			}
+			std::string string(myCursor, size);
+			myCursor += size;
+			return string;
+		}
+
+		// Returns a reader over the next aSize bytes, and skips them
+		EntitySnapshotReader ReadSubReader(size_t aSize)
+		{
+			if (aSize > GetRemainingSize())
+			{
+				myCursor = myEnd;
+				myHasFailed = true;
+				return EntitySnapshotReader(myEnd, 0);
+			}
+			EntitySnapshotReader subReader(myCursor, aSize);
+			myCursor += aSize;
+			return subReader;
+		}
+
+		void SetFailed()
+		{
+			myCursor = myEnd;
+			myHasFailed = true;
+		}
+
+		size_t GetRemainingSize() const { return (size_t)(myEnd - myCursor); }
+		bool HasFailed() const { return myHasFailed; }
+
+	private:
+		const char* myCursor = nullptr;
+		const char* myEnd = nullptr;
+		bool myHasFailed = false;
+	};
+
+	// Components that are not trivially copyable can be saved in snapshots by providing both hooks:
+	// void Serialize(EntitySnapshotWriter& aWriter) const;
+	// Component(EntitySnapshotReader& aReader);
+	template<typename Type>
+	concept SnapshotSerializable = requires(const Type& aComponent, EntitySnapshotWriter& aWriter, EntitySnapshotReader& aReader)
+	{
+		aComponent.Serialize(aWriter);
+		Type(aReader);
+	};
+
+	template<typename Type>
+	constexpr bool ourCanSnapshot = std::is_trivially_copyable_v<Type> || SnapshotSerializable<Type>;
+}
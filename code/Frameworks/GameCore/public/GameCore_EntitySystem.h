@@ -0,0 +1,123 @@
+#pragma once
+
+#include "GameCore_EntityModule.h"
+#include "GameCore_SlotVector.h"
+
+#include <chrono>
+#include <ostream>
+
+namespace GameCore
+{
+	// Used to declare the components a system accesses, ie: AddSystem("Movement", Reads<Velocity>(), Writes<Position>(), ...)
+	template<typename... Types> struct Reads {};
+	template<typename... Types> struct Writes {};
+
+	typedef std::function<void()> EntitySystemFunction;
+	struct EntitySystemEntry
+	{
+		void Clear() { myName.clear(); myFunction = nullptr; }
+		bool IsSet() const { return myFunction != nullptr; }
+
+		// Two systems conflict if one of them writes components the other one reads or writes
+		bool ConflictsWith(const EntitySystemEntry& anOther) const
+		{
+			return myWrites.Intersects(anOther.myReads) || myWrites.Intersects(anOther.myWrites) || myReads.Intersects(anOther.myWrites);
+		}
+
+		std::string myName;
+		ComponentMask myReads;
+		ComponentMask myWrites;
+		EntitySystemFunction myFunction = nullptr;
+		// Set by the scheduler, increasing with each system added
+		uint64 myRegistrationIndex = 0;
+	};
+
+	// Entities are bucketed by their distance to the camera, bucket i being updated once every myFramePeriods[i] frames
+	// The entities of a bucket are spread over its frames by entity index, so far entities cost the same each frame
+	// ie: { { 30.0f, 80.0f }, { 1, 4, 16 } } updates the entities closer than 30 every frame, and the ones further than 80 every 16 frames
+	struct EntityUpdateRates
+	{
+		// Upper bound of each bucket but the last one, increasing
+		std::vector<float> myDistances;
+		// One per bucket, 1 to update every frame
+		std::vector<uint> myFramePeriods;
+	};
+
+	// Selects the entities due each frame for a bucketed system, and accumulates the time elapsed since their last update
+	class EntityUpdateRateBuckets
+	{
+	public:
+		EntityUpdateRateBuckets(const EntityUpdateRates& someRates);
+
+		void Clear();
+		// Keeps anId if its bucket is updated during aFrame
+		// Entities updated for the first time get aFrameDeltaTime
+		void Select(EntityId anId, float aSquaredDistance, uint aFrame, uint64 aTimeNs, float aFrameDeltaTime);
+
+		std::span<const EntityId> GetEntities() const { return myEntities; }
+		std::span<const float> GetDeltaTimes() const { return myDeltaTimes; }
+
+	private:
+		struct LastUpdate
+		{
+			EntityId myEntityId = UINT_MAX;
+			uint64 myTimeNs = 0;
+		};
+
+		std::vector<float> mySquaredDistances;
+		std::vector<uint> myFramePeriods;
+
+		// Indexed by entity index, the id tells whether the slot was reused since
+		std::vector<LastUpdate> myLastUpdates;
+
+		std::vector<EntityId> myEntities;
+		std::vector<float> myDeltaTimes;
+	};
+
+	// Timings of the systems during the last frame, times are relative to the start of the schedule
+	struct EntityScheduleTrace
+	{
+		struct System
+		{
+			std::string myName;
+			uint64 myStartNs = 0;
+			uint64 myEndNs = 0;
+			std::thread::id myThread;
+			bool myIsOnCriticalPath = false;
+		};
+
+		void Print(std::ostream& aStream) const;
+
+		std::vector<System> mySystems;
+		// Chain of dependent systems that finished last, in execution order (indices in mySystems)
+		std::vector<uint> myCriticalPath;
+		uint64 myDurationNs = 0;
+	};
+
+	// Runs the systems each frame, systems that don't conflict may run at the same time on the workers
+	// Conflicting systems run in the order they were added, ids are reused once removed so they don't tell
+	class EntitySystemScheduler
+	{
+	public:
+		uint AddSystem(const EntitySystemEntry& aSystem);
+		void RemoveSystem(uint aSystemId);
+
+		void Run(Thread::WorkerPool& aPool);
+
+		const EntityScheduleTrace& GetLastTrace() const { return myTrace; }
+
+	private:
+		void RebuildGraph();
+		void ComputeCriticalPath();
+
+		SlotVector<EntitySystemEntry> mySystems;
+		uint64 myNextRegistrationIndex = 0;
+
+		// Built from mySystems when they change, indices are in myOrder
+		bool myGraphIsDirty = true;
+		std::vector<uint> myOrder;
+		std::vector<std::vector<uint>> myDependencies;
+
+		EntityScheduleTrace myTrace;
+	};
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "GameCore_TransformKernels.h"
+
 namespace GameCore
 {
 	class Entity3DTransformComponent
@@ -28,7 +30,7 @@ namespace GameCore
 		glm::vec3 GetScale() const { return myScale; }
 
 		// Result Transform Matrix
-		glm::mat4 GetMatrix() const { return glm::translate(glm::mat4(1.0f), myPosition) * glm::toMat4(myOrientation) * glm::scale(myScale); }
+		glm::mat4 GetMatrix() const { return TransformKernels::ComputeAffineMatrix(myPosition, myOrientation, myScale).ToMat4(); }
 
 	private:
 		glm::vec3 myPosition = glm::vec3(0.0f);
@@ -6,6 +6,12 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <span>
+#include <vector>
+#include <array>
+#include <memory>
+#include <new>
+#include <utility>
 
 namespace Thread
 {
@@ -17,70 +23,383 @@ namespace Thread
 		Low
 	};
 
+	// Logical CPUs the process is allowed to run on, grouped by physical core
+	// Read from sysfs on Linux, elsewhere each logical CPU is reported as its own core
+	struct CpuTopology
+	{
+		struct Core
+		{
+			// SMT siblings of the core
+			std::vector<uint> myLogicalCpus;
+			// Cores sharing a last level cache (an L3, or a CCX on AMD) have the same group
+			uint myCacheGroup = 0;
+		};
+
+		// Detected on the first call
+		static const CpuTopology& Get();
+
+		uint GetLogicalCpusCount() const;
+
+		// Sorted by cache group
+		std::vector<Core> myCores;
+		uint myCacheGroupsCount = 1;
+	};
+
+	// Lanes of a WorkerPool, workers always take a job from the most urgent lane that has one
+	enum class JobPriority : uint
+	{
+		// Work the current frame waits for
+		FrameCritical,
+		Normal,
+		// Streaming, decompression... still guaranteed a turn every few jobs so it can't starve
+		Background,
+		Count
+	};
+
+	// Callable stored in place, larger callables fall back to the heap
+	class JobFunction
+	{
+	public:
+		static constexpr uint ourInlineSize = 64;
+
+		JobFunction() = default;
+		JobFunction(const JobFunction&) = delete;
+		JobFunction& operator=(const JobFunction&) = delete;
+		~JobFunction() { Reset(); }
+
+		template<typename Function>
+		void Set(Function&& aFunction)
+		{
+			using Callable = std::decay_t<Function>;
+			Reset();
+			if constexpr (sizeof(Callable) <= ourInlineSize && alignof(Callable) <= alignof(std::max_align_t))
+			{
+				new(myStorage) Callable(std::forward<Function>(aFunction));
+				myInvoke = [](void* aStorage) { (*static_cast<Callable*>(aStorage))(); };
+				myDestroy = [](void* aStorage) { static_cast<Callable*>(aStorage)->~Callable(); };
+			}
+			else
+			{
+				new(myStorage) Callable*(new Callable(std::forward<Function>(aFunction)));
+				myInvoke = [](void* aStorage) { (**static_cast<Callable**>(aStorage))(); };
+				myDestroy = [](void* aStorage) { delete *static_cast<Callable**>(aStorage); };
+			}
+		}
+
+		void Reset()
+		{
+			if (myDestroy)
+				myDestroy(myStorage);
+			myInvoke = nullptr;
+			myDestroy = nullptr;
+		}
+
+		void operator()() { myInvoke(myStorage); }
+		explicit operator bool() const { return myInvoke != nullptr; }
+
+	private:
+		alignas(std::max_align_t) char myStorage[ourInlineSize];
+		void (*myInvoke)(void*) = nullptr;
+		void (*myDestroy)(void*) = nullptr;
+	};
+
+	// Jobs are recycled by their pool, see WorkerPool::AllocateJob
 	struct JobData
 	{
 	private:
 		friend class WorkerPool;
-		void OnDone();
-		void Wait();
+		friend class JobHandle;
+		void AddReference() { myReferencesCount.fetch_add(1, std::memory_order_relaxed); }
+		void RemoveReference();
+		void Wait() const;
 
-		std::function<void()> myFunction;
-		std::mutex myDoneMutex;
-		std::condition_variable myDoneCondition;
-		bool myDone = false;
+		void LockContinuations();
+		void UnlockContinuations() { myContinuationsLock.store(false, std::memory_order_release); }
+
+		// Empty for job groups
+		JobFunction myFunction;
+		WorkerPool* myPool = nullptr;
+		uint myIndex = UINT_MAX;
+		uint myWorkIndex = UINT_MAX;
+		// For groups, only tells which lanes the threads waiting for them help with
+		JobPriority myPriority = JobPriority::Normal;
+
+		// Handles, plus one held by the pool until the job is done
+		std::atomic<uint> myReferencesCount = 0;
+		// Unfinished dependencies, plus one until the job is submitted (or the group closed)
+		std::atomic<uint> myDependenciesCount = 0;
+		// Jobs depending on this one, released once it is done
+		// The capacity is kept when the job is recycled
+		std::vector<JobData*> myContinuations;
+		std::atomic<bool> myContinuationsLock = false;
+
+		std::atomic<bool> myDone = false;
+		// Threads sleeping in WaitForJob until this job is done, FinishJob only wakes them when there are some
+		std::atomic<uint> myWaitersCount = 0;
+		// Next job of the free list of the pool
+		std::atomic<uint> myNextFreeIndex = UINT_MAX;
+	};
+
+	// Reference to a pooled job, the job is recycled once it is done and no handle refers to it anymore
+	// Handles must not outlive the pool that requested the job
+	class JobHandle
+	{
+	public:
+		JobHandle() = default;
+		JobHandle(const JobHandle& anOther) : myJob(anOther.myJob) { if (myJob) myJob->AddReference(); }
+		JobHandle(JobHandle&& anOther) noexcept : myJob(std::exchange(anOther.myJob, nullptr)) {}
+		~JobHandle() { Reset(); }
+
+		JobHandle& operator=(JobHandle anOther)
+		{
+			std::swap(myJob, anOther.myJob);
+			return *this;
+		}
+
+		void Reset()
+		{
+			if (myJob)
+				myJob->RemoveReference();
+			myJob = nullptr;
+		}
+
+		explicit operator bool() const { return myJob != nullptr; }
+		bool IsDone() const { return myJob->myDone.load(std::memory_order_acquire); }
+
+	private:
+		friend class WorkerPool;
+		explicit JobHandle(JobData* aJob) : myJob(aJob) { myJob->AddReference(); }
+
+		JobData* myJob = nullptr;
+	};
+
+	// Lock-free work-stealing deque of jobs (Chase-Lev)
+	// The owner pushes and pops at the bottom, other threads steal from the top
+	class JobDeque
+	{
+	public:
+		JobDeque();
+		~JobDeque();
+
+		// Owner thread only
+		void Push(JobData* aJob);
+		JobData* Pop();
+
+		// Any thread, returns null when empty or when another thread took the job first
+		JobData* Steal();
+
+		bool IsEmpty() const { return myBottom.load(std::memory_order_relaxed) <= myTop.load(std::memory_order_relaxed); }
+
+	private:
+		struct Buffer
+		{
+			Buffer(int64 aCapacity) : myMask(aCapacity - 1), mySlots(new std::atomic<JobData*>[aCapacity]) {}
+			~Buffer() { delete[] mySlots; }
+
+			JobData* Get(int64 anIndex) const { return mySlots[anIndex & myMask].load(std::memory_order_relaxed); }
+			void Put(int64 anIndex, JobData* aJob) { mySlots[anIndex & myMask].store(aJob, std::memory_order_relaxed); }
+
+			int64 myMask;
+			std::atomic<JobData*>* mySlots;
+		};
+
+		Buffer* Grow(Buffer* aBuffer, int64 aBottom, int64 aTop);
+
+		alignas(64) std::atomic<int64> myTop = 0;
+		alignas(64) std::atomic<int64> myBottom = 0;
+		std::atomic<Buffer*> myBuffer;
+		// Stealers may still read the buffers replaced by Grow, they are released with the deque
+		std::vector<Buffer*> myRetiredBuffers;
 	};
-	typedef std::shared_ptr<JobData> JobHandle;
 
 	// Use to start multiple threads which will wait for work to be assigned to them
+	// Each worker runs the jobs of its own deque first, then the jobs requested from other threads, then steals from a random worker
 	class WorkerPool
 	{
 	public:
 		WorkerPool(WorkerPriority aPriority = WorkerPriority::High);
+		~WorkerPool();
 
 #if DEBUG_BUILD
 		void SetWorkersName(const std::string& aBaseName) { myWorkersBaseName = aBaseName; }
 #endif
+		// Pins each worker to a logical CPU: one per physical core first, then on the SMT siblings, filling a cache group before the next
+		// Workers then steal from the workers sharing their cache first. Applied by SetWorkersCount
+		void SetWorkersAffinity(bool aPinToCores) { myPinWorkersToCores = aPinToCores; }
+		// Capped to the logical CPUs the process can run on
 		void SetWorkersCount(uint aCount = UINT_MAX);
 		uint GetWorkersCount() const { return (uint)myWorkers.size(); }
 
-		JobHandle RequestJob(std::function<void()> aJob, uint aWorkIndex = UINT_MAX);
-		void WaitForJob(JobHandle aJobHandle);
+		// Jobs requested from a worker go to its deque for aPriority, others to the injection queue for aPriority
+		// aWorkIndex pins the job to a worker, it then can't be stolen
+		// Without workers, the job runs right away on the calling thread
+		template<typename Function>
+		JobHandle RequestJob(Function&& aJob, uint aWorkIndex = UINT_MAX, JobPriority aPriority = JobPriority::Normal)
+		{
+			return RequestJob(std::forward<Function>(aJob), std::span<const JobHandle>(), aWorkIndex, aPriority);
+		}
+		template<typename Function>
+		JobHandle RequestJob(Function&& aJob, JobPriority aPriority) { return RequestJob(std::forward<Function>(aJob), UINT_MAX, aPriority); }
+		// The job is queued once all someDependencies are done, the calling thread doesn't block
+		template<typename Function>
+		JobHandle RequestJob(Function&& aJob, std::span<const JobHandle> someDependencies, uint aWorkIndex = UINT_MAX, JobPriority aPriority = JobPriority::Normal)
+		{
+			JobData* job = AllocateJob();
+			job->myFunction.Set(std::forward<Function>(aJob));
+			job->myWorkIndex = aWorkIndex;
+			job->myPriority = aPriority;
+			return SubmitJob(job, someDependencies);
+		}
+		template<typename Function>
+		JobHandle RequestJob(Function&& aJob, std::span<const JobHandle> someDependencies, JobPriority aPriority) { return RequestJob(std::forward<Function>(aJob), someDependencies, UINT_MAX, aPriority); }
+		template<typename Function>
+		JobHandle RequestJob(Function&& aJob, std::initializer_list<JobHandle> someDependencies, uint aWorkIndex = UINT_MAX, JobPriority aPriority = JobPriority::Normal)
+		{
+			return RequestJob(std::forward<Function>(aJob), std::span<const JobHandle>(someDependencies.begin(), someDependencies.size()), aWorkIndex, aPriority);
+		}
+		template<typename Function>
+		JobHandle RequestJob(Function&& aJob, std::initializer_list<JobHandle> someDependencies, JobPriority aPriority) { return RequestJob(std::forward<Function>(aJob), someDependencies, UINT_MAX, aPriority); }
+		// Runs aJob once aPreviousJob is done
+		template<typename Function>
+		JobHandle RequestContinuation(const JobHandle& aPreviousJob, Function&& aJob, JobPriority aPriority = JobPriority::Normal) { return RequestJob(std::forward<Function>(aJob), { aPreviousJob }, aPriority); }
+
+		// Priority of the job of this pool the calling thread is running, Normal outside of jobs
+		JobPriority GetCurrentJobPriority() const;
+
+		// A group is a job without function, done once all the jobs added to it are done and it was closed
+		// Jobs can depend on a group, and jobs can be added to it from any thread until it is closed
+		JobHandle CreateJobGroup(JobPriority aPriority = JobPriority::Normal);
+		void AddToJobGroup(const JobHandle& aGroup, const JobHandle& aJob);
+		void CloseJobGroup(const JobHandle& aGroup);
+
+		// Waiting threads run queued jobs until the awaited job is done, and only sleep when there is nothing to take
+		// They only take jobs as urgent as the awaited one, unless all the workers are waiting too
+		// Don't wait while holding a lock that a job may take, the waiting thread can end up running that job
+		void WaitForJob(const JobHandle& aJobHandle);
+		// Waits for all the requested jobs to be done, can't be called from one of them
+		// Jobs waiting for a group that is still open can't be done, WaitIdle asserts and returns once only they are left
 		void WaitIdle();
 
 	private:
+		friend struct JobData;
+
 		struct Worker
 		{
-			Worker(WorkerPool* aPool);
+			Worker(WorkerPool* aPool, uint anIndex, uint aLogicalCpu, uint aCacheGroup);
 			~Worker();
 
-			void AssignJob(JobHandle aJob);
-			void NotifyWaitingJobs();
-			void WaitJobs();
+			void Start();
 			void RunJobs();
-			bool EvaluateWorkToDo();
+			// In the lanes from FrameCritical down to aLowestPriority
+			bool HasPinnedJobs(JobPriority aLowestPriority) const;
 
 			WorkerPool* myPool;
+			uint myIndex;
+			uint myRandomState;
+			// UINT_MAX when the worker isn't pinned
+			uint myLogicalCpu;
+			uint myCacheGroup;
 
 			std::thread myWorkerThread;
 
-			std::mutex myJobQueueMutex;
-			std::condition_variable myWorkToDoCondition;
-			std::condition_variable myWaitForJobsCondition;
-			std::queue<JobHandle> myJobQueue;
+			std::array<JobDeque, (uint)JobPriority::Count> myDeques;
+
+			std::mutex myPinnedJobsMutex;
+			std::array<std::queue<JobData*>, (uint)JobPriority::Count> myPinnedJobs;
+			// Per lane, so that waits only wake up for the pinned jobs they may take
+			std::array<std::atomic<uint>, (uint)JobPriority::Count> myPinnedJobsCounts = {};
+		};
 
-			bool myStopping = false;
+		// Jobs on the stack of the calling thread, to catch waits that can't end
+		struct RunningJob
+		{
+			JobData* myJob;
+			const RunningJob* myPrevious;
 		};
 
-		bool AssignJobTo(Worker* aWorker);
+		static constexpr uint ourJobsBlockSize = 1024;
+		// Waits nested deeper than this block instead of running more jobs, so that the stack stays bounded
+		static constexpr uint ourMaxHelpDepth = 16;
+		// A background job is taken first after this many jobs from the other lanes
+		static constexpr uint ourMaxBackgroundSkips = 32;
+		static constexpr uint ourMaxJobsBlocks = 256;
+
+		// Takes a job from the free list, which grows by blocks when empty
+		JobData* AllocateJob();
+		void FreeJob(JobData* aJob);
+		void AddJobsBlock();
+		JobData* GetJob(uint anIndex) const { return &myJobsBlocks[anIndex / ourJobsBlockSize][anIndex % ourJobsBlockSize]; }
+
+		JobHandle SubmitJob(JobData* aJob, std::span<const JobHandle> someDependencies);
+		// Looks in the lanes from FrameCritical down to aLowestPriority
+		// aWorker is null when the calling thread isn't one of the workers
+		JobData* FindJob(Worker* aWorker, JobPriority aLowestPriority);
+		JobData* FindJobInLane(Worker* aWorker, uint aLane);
+		JobData* PopInjectedJob(uint aLane);
+		JobData* StealJob(uint& aRandomState, const Worker* aThief, uint aLane);
+		bool HasQueuedJobs(JobPriority aLowestPriority) const;
+		// Waits for aJob, or for all the jobs when null, running queued jobs meanwhile
+		void HelpUntilDone(JobData* aJob);
+		bool IsWaitDone(const JobData* aJob) const { return aJob ? aJob->myDone.load() : myPendingJobsCount == 0; }
+		// A group is open, nothing is running or queued and the pending jobs all wait for jobs of this pool: only closing a group can unblock them
+		bool IsIdleWaitStalled() const;
+		void AddDependency(JobData* aJob, JobData* aDependency);
+		void ReleaseDependency(JobData* aJob);
+		void ScheduleJob(JobData* aJob);
+		void RunJob(JobData* aJob);
+		void FinishJob(JobData* aJob);
+		void WakeWorkers(bool anAll);
+		void StopWorkers();
+
+		static thread_local Worker* ourCurrentWorker;
+		static thread_local const RunningJob* ourRunningJobs;
+		static thread_local uint ourHelpDepth;
+		// Steal order of the threads that are not workers
+		static thread_local uint ourHelperRandomState;
 
 #if DEBUG_BUILD
 		std::string myWorkersBaseName;
 #endif
 		WorkerPriority myWorkersPriority;
+		bool myPinWorkersToCores = false;
 		std::vector<std::unique_ptr<Worker>> myWorkers;
 
-		mutable std::mutex myWaitingJobQueueMutex;
-		std::queue<JobHandle> myWaitingJobQueue;
+		// Index of the first free job in the low bits, and a tag incremented by each change in the high bits against ABA
+		std::atomic<uint64> myFreeJobsHead = UINT_MAX;
+		std::mutex myJobsBlocksMutex;
+		std::array<std::unique_ptr<JobData[]>, ourMaxJobsBlocks> myJobsBlocks;
+		uint myJobsBlocksCount = 0;
+
+		std::mutex myInjectedJobsMutex;
+		std::array<std::queue<JobData*>, (uint)JobPriority::Count> myInjectedJobs;
+
+		// Jobs in the deques and the injection queues per lane, not counting the pinned ones
+		std::array<std::atomic<uint>, (uint)JobPriority::Count> myQueuedJobsCounts = {};
+		// Jobs taken from the other lanes by any thread while background jobs were queued
+		std::atomic<uint> myBackgroundSkipsCount = 0;
+		// Requested and not done yet, for WaitIdle
+		std::atomic<uint> myPendingJobsCount = 0;
+		// Pending jobs whose dependencies aren't done yet, counted after being added to the pending ones and removed before being queued
+		std::atomic<uint> myBlockedJobsCount = 0;
+		// Created and not closed yet
+		std::atomic<uint> myOpenGroupsCount = 0;
+		// Inside RunJob, from before the function is called until the job is no longer pending
+		std::atomic<uint> myRunningJobsCount = 0;
+		// Dependencies of jobs of this pool on jobs of other pools that aren't done, those can end without this pool running anything
+		std::atomic<uint> myCrossPoolDependenciesCount = 0;
+
+		std::mutex mySleepMutex;
+		std::condition_variable myWakeCondition;
+		// Also counts the waiting threads that can take jobs, they sleep on myWakeCondition too
+		std::atomic<uint> mySleepingWorkersCount = 0;
+		// Waiting threads only take some lanes, a single notification could be lost on them so they are all woken
+		std::atomic<uint> mySleepingHelpersCount = 0;
+		// Workers inside WaitForJob, when all of them are nobody is left for the lanes the waits skip
+		std::atomic<uint> myWaitingWorkersCount = 0;
+		bool myStopping = false;
+
+		// Threads sleeping in WaitIdle, woken on myWakeCondition when the last pending job is done
+		std::atomic<uint> myIdleWaitersCount = 0;
 	};
 
 	// Use to start a thread that will run a function in a loop until it is stopped
@@ -100,6 +419,7 @@ namespace Thread
 #if DEBUG_BUILD
 		std::string myThreadName;
 #endif
+		WorkerPriority myPriority = WorkerPriority::High;
 		uint mySleepIntervalMs = 0;
 		std::atomic<bool> myStopRequested = false;
 		std::function<void()> myFunction;
@@ -0,0 +1,325 @@
+#pragma once
+
+#include "GameCore_Thread.h"
+
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+
+namespace Thread
+{
+	// Ranges are split in a few pieces per thread so that uneven pieces can balance out
+	static constexpr uint ourParallelPiecesPerThread = 4;
+
+	// Grain size for aCount elements, it adapts to the workers count and never goes below aMinGrainSize
+	inline uint GetParallelGrainSize(const WorkerPool& aPool, uint aCount, uint aMinGrainSize)
+	{
+		const uint piecesCount = (aPool.GetWorkersCount() + 1) * ourParallelPiecesPerThread;
+		return (std::max)({ aMinGrainSize, (aCount + piecesCount - 1) / piecesCount, 1u });
+	}
+
+	// Fixed split of aCount elements in chunks, for the algorithms that combine per chunk results in order
+	inline uint GetParallelChunksCount(const WorkerPool& aPool, uint aCount, uint aMinGrainSize)
+	{
+		const uint grainSize = GetParallelGrainSize(aPool, aCount, aMinGrainSize);
+		return (std::max)((aCount + grainSize - 1) / grainSize, 1u);
+	}
+
+	inline uint GetParallelChunkBegin(uint aChunk, uint aChunksCount, uint aCount)
+	{
+		return (uint)((uint64)aChunk * aCount / aChunksCount);
+	}
+
+	template<typename Function>
+	struct ParallelForContext
+	{
+		WorkerPool* myPool;
+		Function* myFunction;
+		JobHandle myGroup;
+		JobPriority myPriority;
+		uint myGrainSize;
+	};
+
+	// Hands the upper half of the range to another job until it fits in a grain, then runs what is left
+	// Stolen halves split again on their worker, so the work spreads without creating all the jobs up front
+	template<typename Function>
+	void RunParallelRange(ParallelForContext<Function>& aContext, uint aBegin, uint anEnd)
+	{
+		while (anEnd - aBegin > aContext.myGrainSize)
+		{
+			const uint middle = aBegin + (anEnd - aBegin) / 2;
+			ParallelForContext<Function>* context = &aContext;
+			aContext.myPool->AddToJobGroup(aContext.myGroup, aContext.myPool->RequestJob([context, middle, anEnd]() { RunParallelRange(*context, middle, anEnd); }, aContext.myPriority));
+			anEnd = middle;
+		}
+		(*aContext.myFunction)(aBegin, anEnd);
+	}
+
+	// Calls aFunction(aBegin, anEnd) on sub ranges covering [aBegin, anEnd), and returns once they are all done
+	// aFunction is called concurrently from several threads, the calling thread runs the first sub range
+	// The jobs get the priority of the job calling ParallelFor, so a frame critical system keeps its lane
+	template<typename Function>
+	void ParallelFor(WorkerPool& aPool, uint aBegin, uint anEnd, Function&& aFunction, uint aMinGrainSize = 1)
+	{
+		if (aBegin >= anEnd)
+			return;
+
+		const uint grainSize = GetParallelGrainSize(aPool, anEnd - aBegin, aMinGrainSize);
+		if (aPool.GetWorkersCount() == 0 || anEnd - aBegin <= grainSize)
+		{
+			aFunction(aBegin, anEnd);
+			return;
+		}
+
+		using FunctionType = std::remove_reference_t<Function>;
+		const JobPriority priority = aPool.GetCurrentJobPriority();
+		ParallelForContext<FunctionType> context{ &aPool, &aFunction, aPool.CreateJobGroup(priority), priority, grainSize };
+		RunParallelRange(context, aBegin, anEnd);
+		aPool.CloseJobGroup(context.myGroup);
+		aPool.WaitForJob(context.myGroup);
+	}
+
+	// aRangeFunction(aBegin, anEnd, aValue) folds the range into aValue and returns it, aCombine(aLeft, aRight) merges two partial results
+	// Each chunk starts from anIdentity, so it must not change a result when combined
+	// Partial results are combined in range order, so aCombine only needs to be associative
+	template<typename T, typename RangeFunction, typename Combine>
+	T ParallelReduce(WorkerPool& aPool, uint aBegin, uint anEnd, const T& anIdentity, RangeFunction&& aRangeFunction, Combine&& aCombine, uint aMinGrainSize = 1)
+	{
+		if (aBegin >= anEnd)
+			return anIdentity;
+
+		const uint count = anEnd - aBegin;
+		const uint chunksCount = GetParallelChunksCount(aPool, count, aMinGrainSize);
+		if (chunksCount == 1)
+			return aRangeFunction(aBegin, anEnd, anIdentity);
+
+		std::vector<T> results(chunksCount, anIdentity);
+		ParallelFor(aPool, 0, chunksCount, [&](uint aFirstChunk, uint anEndChunk) {
+			for (uint chunk = aFirstChunk; chunk < anEndChunk; chunk++)
+			{
+				const uint begin = aBegin + GetParallelChunkBegin(chunk, chunksCount, count);
+				const uint end = aBegin + GetParallelChunkBegin(chunk + 1, chunksCount, count);
+				results[chunk] = aRangeFunction(begin, end, std::move(results[chunk]));
+			}
+		});
+
+		T result = std::move(results[0]);
+		for (uint chunk = 1; chunk < chunksCount; chunk++)
+			result = aCombine(std::move(result), std::move(results[chunk]));
+		return result;
+	}
+
+	// Scans each chunk twice: once for its total, then again with the combined totals of the chunks before it
+	template<bool Inclusive, typename T, typename Combine>
+	void ParallelScan(WorkerPool& aPool, const T* someInput, T* someOutput, uint aCount, const T& anInitialValue, Combine& aCombine, uint aMinGrainSize)
+	{
+		const uint chunksCount = GetParallelChunksCount(aPool, aCount, aMinGrainSize);
+
+		std::vector<T> carries(chunksCount, anInitialValue);
+		if (chunksCount > 1)
+		{
+			ParallelFor(aPool, 0, chunksCount - 1, [&](uint aFirstChunk, uint anEndChunk) {
+				for (uint chunk = aFirstChunk; chunk < anEndChunk; chunk++)
+				{
+					// Chunks are never empty, the total starts from the first element so anInitialValue is only counted once
+					const uint begin = GetParallelChunkBegin(chunk, chunksCount, aCount);
+					const uint end = GetParallelChunkBegin(chunk + 1, chunksCount, aCount);
+					T total = someInput[begin];
+					for (uint i = begin + 1; i < end; i++)
+						total = aCombine(std::move(total), someInput[i]);
+					carries[chunk + 1] = std::move(total);
+				}
+			});
+			for (uint chunk = 1; chunk < chunksCount; chunk++)
+				carries[chunk] = aCombine(carries[chunk - 1], std::move(carries[chunk]));
+		}
+
+		ParallelFor(aPool, 0, chunksCount, [&](uint aFirstChunk, uint anEndChunk) {
+			for (uint chunk = aFirstChunk; chunk < anEndChunk; chunk++)
+			{
+				T carry = std::move(carries[chunk]);
+				const uint end = GetParallelChunkBegin(chunk + 1, chunksCount, aCount);
+				for (uint i = GetParallelChunkBegin(chunk, chunksCount, aCount); i < end; i++)
+				{
+					// Read before writing so that someInput and someOutput can be the same array
+					T value = someInput[i];
+					if constexpr (Inclusive)
+					{
+						carry = aCombine(std::move(carry), std::move(value));
+						someOutput[i] = carry;
+					}
+					else
+					{
+						someOutput[i] = carry;
+						carry = aCombine(std::move(carry), std::move(value));
+					}
+				}
+			}
+		});
+	}
+
+	// someOutput[i] = anInitialValue + someInput[0] + ... + someInput[i], with aCombine as +
+	// someInput and someOutput can be the same array
+	template<typename T, typename Combine = std::plus<>>
+	void ParallelInclusiveScan(WorkerPool& aPool, const T* someInput, T* someOutput, uint aCount, const T& anInitialValue = T(), Combine aCombine = Combine(), uint aMinGrainSize = 1024)
+	{
+		ParallelScan<true>(aPool, someInput, someOutput, aCount, anInitialValue, aCombine, aMinGrainSize);
+	}
+
+	// someOutput[i] = anInitialValue + someInput[0] + ... + someInput[i - 1], with aCombine as +
+	// someInput and someOutput can be the same array
+	template<typename T, typename Combine = std::plus<>>
+	void ParallelExclusiveScan(WorkerPool& aPool, const T* someInput, T* someOutput, uint aCount, const T& anInitialValue = T(), Combine aCombine = Combine(), uint aMinGrainSize = 1024)
+	{
+		ParallelScan<false>(aPool, someInput, someOutput, aCount, anInitialValue, aCombine, aMinGrainSize);
+	}
+
+	// Number of elements of someLeft among the first anOutputIndex elements of the stable merge of someLeft and someRight
+	template<typename T, typename Compare>
+	uint GetMergeSplit(const T* someLeft, uint aLeftCount, const T* someRight, uint aRightCount, uint anOutputIndex, Compare& aCompare)
+	{
+		uint low = anOutputIndex > aRightCount ? anOutputIndex - aRightCount : 0;
+		uint high = (std::min)(anOutputIndex, aLeftCount);
+		while (low < high)
+		{
+			const uint middle = low + (high - low) / 2;
+			if (aCompare(someRight[anOutputIndex - middle - 1], someLeft[middle]))
+				high = middle;
+			else
+				low = middle + 1;
+		}
+		return low;
+	}
+
+	// Stable sort: runs are sorted in parallel, then merged pairwise
+	// When there are fewer merges than threads, each merge is itself split at balanced points of the output
+	template<typename T, typename Compare = std::less<>>
+	void ParallelSort(WorkerPool& aPool, T* someData, uint aCount, Compare aCompare = Compare(), uint aMinGrainSize = 2048)
+	{
+		if (aCount < 2)
+			return;
+
+		const uint runsCount = GetParallelChunksCount(aPool, aCount, aMinGrainSize);
+		if (runsCount == 1)
+		{
+			std::stable_sort(someData, someData + aCount, aCompare);
+			return;
+		}
+
+		const uint runSize = (aCount + runsCount - 1) / runsCount;
+		ParallelFor(aPool, 0, runsCount, [&](uint aFirstRun, uint anEndRun) {
+			for (uint run = aFirstRun; run < anEndRun; run++)
+			{
+				const uint begin = (std::min)(run * runSize, aCount);
+				const uint end = (std::min)(begin + runSize, aCount);
+				std::stable_sort(someData + begin, someData + end, aCompare);
+			}
+		});
+
+		std::vector<T> buffer(aCount);
+		T* source = someData;
+		T* destination = buffer.data();
+		const uint piecesCount = (aPool.GetWorkersCount() + 1) * ourParallelPiecesPerThread;
+		for (uint width = runSize; width < aCount; width = width > aCount / 2 ? aCount : width * 2)
+		{
+			const uint mergesCount = (aCount + 2 * width - 1) / (2 * width);
+			const uint splitsCount = (std::max)(piecesCount / mergesCount, 1u);
+			ParallelFor(aPool, 0, mergesCount * splitsCount, [&](uint aFirstPiece, uint anEndPiece) {
+				for (uint piece = aFirstPiece; piece < anEndPiece; piece++)
+				{
+					const uint begin = piece / splitsCount * 2 * width;
+					const uint middle = (std::min)(begin + width, aCount);
+					const uint end = (std::min)(middle + width, aCount);
+					const T* left = source + begin;
+					const T* right = source + middle;
+					const uint leftCount = middle - begin;
+					const uint rightCount = end - middle;
+
+					const uint split = piece % splitsCount;
+					const uint outputBegin = GetParallelChunkBegin(split, splitsCount, end - begin);
+					const uint outputEnd = GetParallelChunkBegin(split + 1, splitsCount, end - begin);
+					const uint leftBegin = GetMergeSplit(left, leftCount, right, rightCount, outputBegin, aCompare);
+					const uint leftEnd = GetMergeSplit(left, leftCount, right, rightCount, outputEnd, aCompare);
+					std::merge(std::make_move_iterator(source + begin + leftBegin), std::make_move_iterator(source + begin + leftEnd),
+						std::make_move_iterator(source + middle + outputBegin - leftBegin), std::make_move_iterator(source + middle + outputEnd - leftEnd),
+						destination + begin + outputBegin, aCompare);
+				}
+			});
+			std::swap(source, destination);
+		}
+
+		if (source != someData)
+		{
+			ParallelFor(aPool, 0, aCount, [&](uint aBegin, uint anEnd) {
+				std::move(source + aBegin, source + anEnd, someData + aBegin);
+			}, aMinGrainSize);
+		}
+	}
+
+	// Stable LSD radix sort on the unsigned integer returned by aKeyFunction(const T&), 8 bits per pass
+	// Each chunk counts its digits, then moves its elements to the offsets given by the digit counts of all chunks
+	// Passes where all the elements share the same digit are skipped, so small keys in a wide type are cheap
+	template<typename T, typename KeyFunction>
+	void ParallelRadixSort(WorkerPool& aPool, T* someData, uint aCount, KeyFunction aKeyFunction, uint aMinGrainSize = 4096)
+	{
+		using Key = std::decay_t<decltype(aKeyFunction(*someData))>;
+		static_assert(std::is_unsigned_v<Key>, "Radix sort keys must be unsigned integers!");
+		static constexpr uint ourDigitsCount = 256;
+
+		if (aCount < 2)
+			return;
+
+		const uint chunksCount = GetParallelChunksCount(aPool, aCount, aMinGrainSize);
+		std::vector<uint> offsets(chunksCount * ourDigitsCount);
+		std::vector<T> buffer(aCount);
+		T* source = someData;
+		T* destination = buffer.data();
+		for (uint shift = 0; shift < sizeof(Key) * 8; shift += 8)
+		{
+			ParallelFor(aPool, 0, chunksCount, [&](uint aFirstChunk, uint anEndChunk) {
+				for (uint chunk = aFirstChunk; chunk < anEndChunk; chunk++)
+				{
+					uint* counts = &offsets[chunk * ourDigitsCount];
+					std::fill(counts, counts + ourDigitsCount, 0u);
+					const uint end = GetParallelChunkBegin(chunk + 1, chunksCount, aCount);
+					for (uint i = GetParallelChunkBegin(chunk, chunksCount, aCount); i < end; i++)
+						counts[(aKeyFunction(source[i]) >> shift) & (ourDigitsCount - 1)]++;
+				}
+			});
+
+			// Digits first then chunks, so that the elements of a chunk land after those of the previous chunks with the same digit
+			uint offset = 0;
+			bool isSingleDigit = false;
+			for (uint digit = 0; digit < ourDigitsCount && !isSingleDigit; digit++)
+			{
+				for (uint chunk = 0; chunk < chunksCount; chunk++)
+				{
+					const uint count = offsets[chunk * ourDigitsCount + digit];
+					offsets[chunk * ourDigitsCount + digit] = offset;
+					offset += count;
+				}
+				isSingleDigit = offset == aCount && offsets[digit] == 0;
+			}
+			if (isSingleDigit)
+				continue;
+
+			ParallelFor(aPool, 0, chunksCount, [&](uint aFirstChunk, uint anEndChunk) {
+				for (uint chunk = aFirstChunk; chunk < anEndChunk; chunk++)
+				{
+					uint* chunkOffsets = &offsets[chunk * ourDigitsCount];
+					const uint end = GetParallelChunkBegin(chunk + 1, chunksCount, aCount);
+					for (uint i = GetParallelChunkBegin(chunk, chunksCount, aCount); i < end; i++)
+						destination[chunkOffsets[(aKeyFunction(source[i]) >> shift) & (ourDigitsCount - 1)]++] = std::move(source[i]);
+				}
+			});
+			std::swap(source, destination);
+		}
+
+		if (source != someData)
+		{
+			ParallelFor(aPool, 0, aCount, [&](uint aBegin, uint anEnd) {
+				std::move(source + aBegin, source + anEnd, someData + aBegin);
+			}, aMinGrainSize);
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+namespace GameCore
+{
+	// 3x4 matrix stored by rows, the implicit last row is (0, 0, 0, 1)
+	struct AffineMatrix
+	{
+		glm::mat4 ToMat4() const { return glm::transpose(glm::mat4(myRows[0], myRows[1], myRows[2], glm::vec4(0.0f, 0.0f, 0.0f, 1.0f))); }
+
+		glm::vec4 myRows[3];
+	};
+
+	namespace TransformKernels
+	{
+		// translate(aPosition) * rotate(anOrientation) * scale(aScale)
+		inline AffineMatrix ComputeAffineMatrix(const glm::vec3& aPosition, const glm::quat& anOrientation, const glm::vec3& aScale)
+		{
+			const float xx = anOrientation.x * anOrientation.x, yy = anOrientation.y * anOrientation.y, zz = anOrientation.z * anOrientation.z;
+			const float xy = anOrientation.x * anOrientation.y, xz = anOrientation.x * anOrientation.z, yz = anOrientation.y * anOrientation.z;
+			const float wx = anOrientation.w * anOrientation.x, wy = anOrientation.w * anOrientation.y, wz = anOrientation.w * anOrientation.z;
+
+			AffineMatrix matrix;
+			matrix.myRows[0] = glm::vec4((1.0f - 2.0f * (yy + zz)) * aScale.x, 2.0f * (xy - wz) * aScale.y, 2.0f * (xz + wy) * aScale.z, aPosition.x);
+			matrix.myRows[1] = glm::vec4(2.0f * (xy + wz) * aScale.x, (1.0f - 2.0f * (xx + zz)) * aScale.y, 2.0f * (yz - wx) * aScale.z, aPosition.y);
+			matrix.myRows[2] = glm::vec4(2.0f * (xz - wy) * aScale.x, 2.0f * (yz + wx) * aScale.y, (1.0f - 2.0f * (xx + yy)) * aScale.z, aPosition.z);
+			return matrix;
+		}
+
+		// Batch versions, using AVX or SSE when the CPU supports them
+		// Inputs and outputs are plain arrays of aCount elements, ie: the field spans of an SoA container
+
+		void ComputeAffineMatrices(const glm::vec3* somePositions, const glm::quat* someOrientations, const glm::vec3* someScales, uint aCount, AffineMatrix* someOutMatrices);
+
+		// Inverse transpose of rotate(anOrientation) * scale(aScale), to transform normals
+		// The translation column is left at 0
+		void ComputeNormalMatrices(const glm::quat* someOrientations, const glm::vec3* someScales, uint aCount, AffineMatrix* someOutMatrices);
+	}
+}
@@ -0,0 +1,103 @@
+#include "GameCore_Tests.h"
+#include "GameCore_EntityModule.h"
+
+namespace GameCore::Tests
+{
+	namespace
+	{
+		// Not trivially copyable, so that relocations go through the move constructor
+		struct Name
+		{
+			Name(const std::string& aValue) : myValue(aValue) {}
+
+			std::string myValue;
+		};
+
+		bool IsPacked(const ComponentContainer<Name>& aContainer)
+		{
+			bool isPacked = true;
+			for (uint i = 0; i < aContainer.GetSize(); ++i)
+			{
+				const EntityId entityId = aContainer.GetEntityId(i);
+				isPacked &= aContainer.GetComponent(entityId) == aContainer.GetAt(i);
+				isPacked &= aContainer.GetAt(i)->myValue == std::to_string(GetEntityIndex(entityId));
+			}
+			return isPacked;
+		}
+
+		// The last component fills the hole left by a removal
+		void TestSwapAndPop()
+		{
+			ComponentContainer<Name> container;
+			for (uint i = 0; i < 5; ++i)
+				container.AddComponent(MakeEntityId(i, 0), std::to_string(i));
+
+			container.RemoveComponent(MakeEntityId(1, 0));
+			TestCheck(container.GetSize() == 4);
+			TestCheck(container.GetEntityId(1) == MakeEntityId(4, 0));
+			TestCheck(container.GetAt(1)->myValue == "4");
+			TestCheck(!container.HasComponent(MakeEntityId(1, 0)));
+			TestCheck(IsPacked(container));
+
+			// Removing the last one moves nothing
+			container.RemoveComponent(MakeEntityId(3, 0));
+			TestCheck(container.GetSize() == 3);
+			TestCheck(container.GetEntityId(2) == MakeEntityId(2, 0));
+			TestCheck(IsPacked(container));
+
+			// Missing ones are ignored
+			container.RemoveComponent(MakeEntityId(3, 0));
+			container.RemoveComponent(MakeEntityId(100, 0));
+			TestCheck(container.GetSize() == 3);
+
+			container.AddComponent(MakeEntityId(1, 0), "1");
+			TestCheck(container.GetEntityId(3) == MakeEntityId(1, 0));
+			TestCheck(IsPacked(container));
+		}
+
+		// Entity indices spread over several sparse pages and chunks
+		void TestSparseIndices()
+		{
+			ComponentContainer<Name> container;
+			std::vector<uint> indices;
+			for (uint i = 0; i < 600; ++i)
+				indices.push_back((i * 7919) % 20000);
+			for (uint index : indices)
+				container.AddComponent(MakeEntityId(index, 0), std::to_string(index));
+			TestCheck(container.GetSize() == 600);
+			TestCheck(IsPacked(container));
+
+			for (uint i = 0; i < (uint)indices.size(); i += 3)
+				container.RemoveComponent(MakeEntityId(indices[i], 0));
+			TestCheck(container.GetSize() == 400);
+			TestCheck(IsPacked(container));
+
+			container.ShrinkToFit();
+			TestCheck(IsPacked(container));
+			for (uint i = 0; i < (uint)indices.size(); ++i)
+				TestCheck(container.HasComponent(MakeEntityId(indices[i], 0)) == (i % 3 != 0));
+		}
+
+		// Ids sharing the index of a component with another generation don't find it
+		void TestGenerations()
+		{
+			ComponentContainer<Name> container;
+			container.AddComponent(MakeEntityId(7, 2), "7");
+			TestCheck(container.HasComponent(MakeEntityId(7, 2)));
+			TestCheck(!container.HasComponent(MakeEntityId(7, 1)));
+			TestCheck(!container.HasComponent(MakeEntityId(7, 3)));
+			TestCheck(container.GetComponent(MakeEntityId(7, 3)) == nullptr);
+
+			container.RemoveComponent(MakeEntityId(7, 1));
+			TestCheck(container.GetSize() == 1);
+		}
+	}
+}
+
+int main()
+{
+	GameCore::Tests::TestSwapAndPop();
+	GameCore::Tests::TestSparseIndices();
+	GameCore::Tests::TestGenerations();
+	return (int)GameCore::Tests::ourFailedChecksCount;
+}
@@ -0,0 +1,76 @@
+#include "GameCore_Tests.h"
+#include "GameCore_EntityModule.h"
+
+namespace GameCore::Tests
+{
+	namespace
+	{
+		struct Health
+		{
+			int myValue = 0;
+		};
+
+		struct Unused
+		{
+			int myValue = 0;
+		};
+
+		bool HasChangedThisTick(const EntityWorld& aWorld, EntityId anId)
+		{
+			return aWorld.GetComponentContainer<Health>()->HasChangedSince(anId, aWorld.GetChangeTick());
+		}
+
+		void TestReadsAreUntracked()
+		{
+			EntityWorld world;
+			const EntityId entityId = world.Create();
+			world.AddComponent<Health>(entityId, 3);
+			TestCheck(HasChangedThisTick(world, entityId));
+
+			world.AdvanceChangeTick();
+			TestCheck(!HasChangedThisTick(world, entityId));
+			TestCheck(world.ReadComponent<Health>(entityId)->myValue == 3);
+			const EntityWorld& constWorld = world;
+			TestCheck(constWorld.GetComponent<Health>(entityId)->myValue == 3);
+			TestCheck(!HasChangedThisTick(world, entityId));
+
+			// Missing types are not created by reads
+			TestCheck(world.ReadComponent<Unused>(entityId) == nullptr);
+			world.MarkChanged<Unused>(entityId);
+			TestCheck(constWorld.GetComponentContainer<Unused>() == nullptr);
+		}
+
+		void TestWritesAreTracked()
+		{
+			EntityWorld world;
+			const EntityId entityId = world.Create();
+			const EntityId otherId = world.Create();
+			world.AddComponent<Health>(entityId, 3);
+			world.AddComponent<Health>(otherId, 4);
+
+			world.AdvanceChangeTick();
+			world.GetComponent<Health>(entityId)->myValue = 5;
+			TestCheck(HasChangedThisTick(world, entityId));
+			TestCheck(!HasChangedThisTick(world, otherId));
+
+			world.AdvanceChangeTick();
+			world.ReplaceComponent<Health>(entityId, 6);
+			TestCheck(HasChangedThisTick(world, entityId));
+
+			world.AdvanceChangeTick();
+			for (const auto& [health] : world.View<Health>())
+				health->myValue++;
+			TestCheck(!HasChangedThisTick(world, otherId));
+			world.MarkChanged<Health>(otherId);
+			TestCheck(HasChangedThisTick(world, otherId));
+			TestCheck(!HasChangedThisTick(world, entityId));
+		}
+	}
+}
+
+int main()
+{
+	GameCore::Tests::TestReadsAreUntracked();
+	GameCore::Tests::TestWritesAreTracked();
+	return (int)GameCore::Tests::ourFailedChecksCount;
+}
@@ -0,0 +1,109 @@
+#include "GameCore_Tests.h"
+#include "GameCore_EntityCommandBuffer.h"
+
+namespace GameCore::Tests
+{
+	namespace
+	{
+		struct Health
+		{
+			int myValue = 0;
+		};
+
+		struct Enemy {};
+
+		void TestCreateAndAdd()
+		{
+			EntityWorld world;
+			EntityCommandBuffer buffer;
+			const EntityId placeholder = buffer.Create();
+			buffer.AddComponent<Health>(placeholder, 5);
+			buffer.AddComponent<Enemy>(placeholder);
+			TestCheck(!buffer.IsEmpty());
+
+			buffer.Apply(world);
+			TestCheck(buffer.IsEmpty());
+			TestCheck(world.GetComponentContainer<Health>()->GetSize() == 1);
+			const EntityId entityId = world.GetComponentContainer<Health>()->GetEntityId(0);
+			TestCheck(world.Exists(entityId));
+			TestCheck(world.GetComponent<Health>(entityId)->myValue == 5);
+			TestCheck(world.HasComponent<Enemy>(entityId));
+		}
+
+		// Buffer A destroys the entity, buffer B applied after it still refers to it
+		void TestDestroyThenAddInAnotherBuffer()
+		{
+			EntityWorld world;
+			const EntityId entityId = world.Create();
+			world.AddComponent<Health>(entityId, 1);
+
+			EntityCommandBuffer destroyBuffer;
+			EntityCommandBuffer addBuffer;
+			destroyBuffer.Destroy(entityId);
+			addBuffer.AddComponent<Enemy>(entityId);
+			addBuffer.RemoveComponent<Health>(entityId);
+			destroyBuffer.Apply(world);
+			addBuffer.Apply(world);
+
+			TestCheck(!world.Exists(entityId));
+			TestCheck(world.GetComponentContainer<Health>()->GetSize() == 0);
+			TestCheck(world.GetComponentContainer<Enemy>()->GetSize() == 0);
+
+			// The recycled slot must not inherit anything
+			const EntityId recycledId = world.Create();
+			TestCheck(GetEntityIndex(recycledId) == GetEntityIndex(entityId));
+			TestCheck(!world.HasComponent<Enemy>(recycledId));
+			TestCheck(!world.HasComponent<Health>(recycledId));
+		}
+
+		// The entity is destroyed right away while a buffer still holds commands for it
+		void TestDestroyedBeforeApply()
+		{
+			EntityWorld world;
+			std::vector<EntityId> entities(4);
+			world.CreateMany(entities);
+
+			EntityCommandBuffer buffer;
+			for (EntityId entityId : entities)
+				buffer.AddComponent<Health>(entityId, (int)GetEntityIndex(entityId));
+			world.Destroy(entities[1]);
+			world.Destroy(entities[2]);
+			const EntityId recycledId = world.Create();
+			buffer.Apply(world);
+
+			ComponentContainer<Health>* healths = world.GetComponentContainer<Health>();
+			TestCheck(healths->GetSize() == 2);
+			TestCheck(healths->GetComponent(entities[0]) && healths->GetComponent(entities[0])->myValue == 0);
+			TestCheck(healths->GetComponent(entities[3]) && healths->GetComponent(entities[3])->myValue == 3);
+			TestCheck(!healths->GetComponent(entities[1]) && !healths->GetComponent(entities[2]));
+			TestCheck(!healths->GetComponent(recycledId));
+		}
+
+		// Within one buffer, components are applied before destructions
+		void TestAddThenDestroyInSameBuffer()
+		{
+			EntityWorld world;
+			EntityCommandBuffer buffer;
+			const EntityId placeholder = buffer.Create();
+			buffer.AddComponent<Health>(placeholder, 1);
+			buffer.Destroy(placeholder);
+			const EntityId survivor = buffer.Create();
+			buffer.AddComponent<Health>(survivor, 2);
+			buffer.Apply(world);
+
+			ComponentContainer<Health>* healths = world.GetComponentContainer<Health>();
+			TestCheck(healths->GetSize() == 1);
+			TestCheck(healths->GetAt(0)->myValue == 2);
+			TestCheck(world.Exists(healths->GetEntityId(0)));
+		}
+	}
+}
+
+int main()
+{
+	GameCore::Tests::TestCreateAndAdd();
+	GameCore::Tests::TestDestroyThenAddInAnotherBuffer();
+	GameCore::Tests::TestDestroyedBeforeApply();
+	GameCore::Tests::TestAddThenDestroyInSameBuffer();
+	return (int)GameCore::Tests::ourFailedChecksCount;
+}
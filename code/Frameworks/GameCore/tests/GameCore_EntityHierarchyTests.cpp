@@ -0,0 +1,108 @@
+#include "GameCore_Tests.h"
+#include "GameCore_EntityModule.h"
+#include "GameCore_EntityTransformComponent.h"
+
+namespace GameCore::Tests
+{
+	namespace
+	{
+		bool IsNear(const glm::vec3& aValue, const glm::vec3& anExpected)
+		{
+			return glm::all(glm::lessThan(glm::abs(aValue - anExpected), glm::vec3(0.0001f)));
+		}
+
+		glm::vec3 GetWorldPosition(const EntityWorld& aWorld, EntityId anId)
+		{
+			return glm::vec3(aWorld.GetWorldMatrix(anId)[3]);
+		}
+
+		void TestParentToChild()
+		{
+			EntityWorld world;
+			const EntityId parent = world.Create();
+			const EntityId child = world.Create();
+			const EntityId grandChild = world.Create();
+			world.AddComponent<Entity3DTransformComponent>(parent, glm::vec3(1.0f, 0.0f, 0.0f));
+			world.AddComponent<Entity3DTransformComponent>(child, glm::vec3(0.0f, 2.0f, 0.0f));
+			world.AddComponent<Entity3DTransformComponent>(grandChild, glm::vec3(0.0f, 0.0f, 3.0f));
+			world.SetParent(child, parent);
+			world.SetParent(grandChild, child);
+			world.UpdateHierarchy();
+
+			TestCheck(IsNear(GetWorldPosition(world, parent), glm::vec3(1.0f, 0.0f, 0.0f)));
+			TestCheck(IsNear(GetWorldPosition(world, child), glm::vec3(1.0f, 2.0f, 0.0f)));
+			TestCheck(IsNear(GetWorldPosition(world, grandChild), glm::vec3(1.0f, 2.0f, 3.0f)));
+
+			// Scaled parent
+			world.GetComponent<Entity3DTransformComponent>(parent)->SetScale(2.0f);
+			world.AdvanceChangeTick();
+			world.UpdateHierarchy();
+			TestCheck(IsNear(GetWorldPosition(world, child), glm::vec3(1.0f, 4.0f, 0.0f)));
+			TestCheck(IsNear(GetWorldPosition(world, grandChild), glm::vec3(1.0f, 4.0f, 6.0f)));
+
+			// Back to a root
+			world.SetParent(child, UINT_MAX);
+			world.AdvanceChangeTick();
+			world.UpdateHierarchy();
+			TestCheck(IsNear(GetWorldPosition(world, child), glm::vec3(0.0f, 2.0f, 0.0f)));
+			TestCheck(IsNear(GetWorldPosition(world, grandChild), glm::vec3(0.0f, 2.0f, 3.0f)));
+		}
+
+		// A transform changed after the update of its tick, like a module update running after the EntityModule one
+		void TestChangeAfterUpdateInSameTick()
+		{
+			EntityWorld world;
+			const EntityId parent = world.Create();
+			const EntityId child = world.Create();
+			world.AddComponent<Entity3DTransformComponent>(parent, glm::vec3(0.0f));
+			world.AddComponent<Entity3DTransformComponent>(child, glm::vec3(0.0f, 1.0f, 0.0f));
+			world.SetParent(child, parent);
+			world.UpdateHierarchy();
+
+			for (uint frame = 1; frame <= 3; ++frame)
+			{
+				world.AdvanceChangeTick();
+				world.UpdateHierarchy();
+				world.GetComponent<Entity3DTransformComponent>(parent)->SetPosition(glm::vec3((float)frame, 0.0f, 0.0f));
+			}
+			TestCheck(IsNear(GetWorldPosition(world, child), glm::vec3(2.0f, 1.0f, 0.0f)));
+
+			world.AdvanceChangeTick();
+			world.UpdateHierarchy();
+			TestCheck(IsNear(GetWorldPosition(world, parent), glm::vec3(3.0f, 0.0f, 0.0f)));
+			TestCheck(IsNear(GetWorldPosition(world, child), glm::vec3(3.0f, 1.0f, 0.0f)));
+		}
+
+		// Unchanged transforms keep their world matrices over the following ticks
+		void TestStableAcrossTicks()
+		{
+			EntityWorld world;
+			const EntityId parent = world.Create();
+			const EntityId child = world.Create();
+			world.AddComponent<Entity3DTransformComponent>(parent, glm::vec3(5.0f, 0.0f, 0.0f));
+			world.AddComponent<Entity3DTransformComponent>(child, glm::vec3(0.0f, 0.0f, 1.0f));
+			world.SetParent(child, parent);
+			world.UpdateHierarchy();
+
+			for (uint frame = 0; frame < 3; ++frame)
+			{
+				world.AdvanceChangeTick();
+				world.UpdateHierarchy();
+				TestCheck(IsNear(GetWorldPosition(world, child), glm::vec3(5.0f, 0.0f, 1.0f)));
+			}
+
+			world.GetComponent<Entity3DTransformComponent>(child)->Translate(glm::vec3(0.0f, 0.0f, 1.0f));
+			world.AdvanceChangeTick();
+			world.UpdateHierarchy();
+			TestCheck(IsNear(GetWorldPosition(world, child), glm::vec3(5.0f, 0.0f, 2.0f)));
+		}
+	}
+}
+
+int main()
+{
+	GameCore::Tests::TestParentToChild();
+	GameCore::Tests::TestChangeAfterUpdateInSameTick();
+	GameCore::Tests::TestStableAcrossTicks();
+	return (int)GameCore::Tests::ourFailedChecksCount;
+}
@@ -0,0 +1,186 @@
+#include "GameCore_Tests.h"
+#include "GameCore_EntityModule.h"
+
+namespace GameCore::Tests
+{
+	namespace
+	{
+		struct Health
+		{
+			int myValue = 0;
+		};
+
+		struct Name
+		{
+			Name(const std::string& aValue) : myValue(aValue) {}
+			Name(EntitySnapshotReader& aReader) : myValue(aReader.ReadString()) {}
+			void Serialize(EntitySnapshotWriter& aWriter) const { aWriter.Write(myValue); }
+
+			std::string myValue;
+		};
+
+		struct Enemy {};
+
+		// Same component types in both worlds, restoring matches the containers by type name
+		void RegisterComponents(EntityWorld& aWorld)
+		{
+			aWorld.GetComponentId<Health>();
+			aWorld.GetComponentId<Name>();
+			aWorld.GetComponentId<Enemy>();
+		}
+
+		void TestRoundTrip()
+		{
+			EntityWorld source;
+			RegisterComponents(source);
+
+			std::vector<EntityId> entities(300);
+			source.CreateMany(entities);
+			for (uint i = 0; i < (uint)entities.size(); ++i)
+			{
+				source.AddComponent<Health>(entities[i], Health{ (int)i });
+				if (i % 3 == 0)
+					source.AddComponent<Name>(entities[i], "entity " + std::to_string(i));
+				if (i % 5 == 0)
+					source.AddComponent<Enemy>(entities[i]);
+			}
+			// Leaves free slots with bumped generations
+			for (uint i = 0; i < (uint)entities.size(); i += 7)
+				source.Destroy(entities[i]);
+
+			std::vector<char> data;
+			source.SaveSnapshot(data);
+
+			EntityWorld restored;
+			RegisterComponents(restored);
+			restored.Create();
+			TestCheck(restored.RestoreSnapshot(data.data(), data.size()));
+
+			for (uint i = 0; i < (uint)entities.size(); ++i)
+			{
+				const EntityId entityId = entities[i];
+				TestCheck(restored.Exists(entityId) == source.Exists(entityId));
+				if (!source.Exists(entityId))
+					continue;
+
+				const Health* health = restored.GetComponent<Health>(entityId);
+				TestCheck(health && health->myValue == (int)i);
+				const Name* name = restored.GetComponent<Name>(entityId);
+				TestCheck((name != nullptr) == (i % 3 == 0));
+				if (name)
+					TestCheck(name->myValue == "entity " + std::to_string(i));
+				TestCheck(restored.HasComponent<Enemy>(entityId) == (i % 5 == 0));
+			}
+
+			// The free list is restored too: new entities reuse the destroyed slots, never an alive one
+			const EntityId recycledId = restored.Create();
+			TestCheck(recycledId == source.Create());
+			TestCheck(!restored.HasComponent<Health>(recycledId));
+
+			// Saving the restored world gives the same bytes
+			std::vector<char> restoredData;
+			EntityWorld copy;
+			RegisterComponents(copy);
+			TestCheck(copy.RestoreSnapshot(data.data(), data.size()));
+			copy.SaveSnapshot(restoredData);
+			TestCheck(restoredData == data);
+		}
+
+		void TestInvalidSnapshots()
+		{
+			EntityWorld source;
+			RegisterComponents(source);
+			for (uint i = 0; i < 10; ++i)
+				source.AddComponent<Health>(source.Create(), Health{ (int)i });
+			source.Destroy(MakeEntityId(4, 0));
+
+			std::vector<char> data;
+			source.SaveSnapshot(data);
+
+			EntityWorld restored;
+			RegisterComponents(restored);
+
+			// Truncated data
+			for (size_t size : { (size_t)0, (size_t)7, data.size() / 2, data.size() - 1 })
+				TestCheck(!restored.RestoreSnapshot(data.data(), size));
+
+			// Magic, version, change tick, entities count, entities, then the free list head, tail and count
+			const size_t freeListOffset = 4 * sizeof(uint) + 10 * sizeof(EntityId);
+			auto restoreWithFreeList = [&](uint aHead, uint aTail, uint aCount) {
+				std::vector<char> corrupted = data;
+				const uint freeList[] = { aHead, aTail, aCount };
+				std::memcpy(corrupted.data() + freeListOffset, freeList, sizeof(freeList));
+				return restored.RestoreSnapshot(corrupted.data(), corrupted.size());
+			};
+			TestCheck(restoreWithFreeList(4, 4, 1));
+			TestCheck(!restoreWithFreeList(10, 10, 1));
+			TestCheck(!restoreWithFreeList(4, 99, 1));
+			TestCheck(!restoreWithFreeList(4, 4, 11));
+			TestCheck(!restoreWithFreeList(4, 4, 2));
+			// Slot 3 is alive
+			TestCheck(!restoreWithFreeList(3, 3, 1));
+			TestCheck(restored.GetComponentContainer<Health>()->GetSize() == 0);
+
+			// The world is usable after a failed restore
+			const EntityId entityId = restored.Create();
+			restored.AddComponent<Health>(entityId, Health{ 1 });
+			TestCheck(restored.GetComponent<Health>(entityId)->myValue == 1);
+		}
+
+		// Containers must only refer to alive entities, once each
+		void TestInvalidComponents()
+		{
+			EntityWorld source;
+			RegisterComponents(source);
+			for (uint i = 0; i < 10; ++i)
+				source.AddComponent<Health>(source.Create(), Health{ (int)i });
+			source.AddComponent<Enemy>(MakeEntityId(0, 0));
+			source.AddComponent<Enemy>(MakeEntityId(2, 0));
+			source.Destroy(MakeEntityId(4, 0));
+
+			std::vector<char> data;
+			source.SaveSnapshot(data);
+
+			// The data of a container follows its type name and the size of the data
+			auto getDataOffset = [&data](const char* aTypeName) {
+				const std::string_view typeName(aTypeName);
+				const auto it = std::search(data.begin(), data.end(), typeName.begin(), typeName.end());
+				return (size_t)(it - data.begin()) + typeName.size() + sizeof(uint64);
+			};
+			const size_t healthIdsOffset = getDataOffset(typeid(Health).name()) + sizeof(uint);
+			const size_t enemyBitsOffset = getDataOffset(typeid(Enemy).name()) + sizeof(uint);
+
+			EntityWorld restored;
+			RegisterComponents(restored);
+			auto restoreWith = [&](size_t anOffset, const auto& aValue) {
+				std::vector<char> corrupted = data;
+				std::memcpy(corrupted.data() + anOffset, &aValue, sizeof(aValue));
+				return restored.RestoreSnapshot(corrupted.data(), corrupted.size());
+			};
+			TestCheck(restoreWith(healthIdsOffset, MakeEntityId(0, 0)));
+			TestCheck(restored.GetComponentContainer<Health>()->GetSize() == 9);
+			TestCheck(restored.HasComponent<Enemy>(MakeEntityId(2, 0)));
+
+			// Destroyed, stale and listed twice
+			TestCheck(!restoreWith(healthIdsOffset, MakeEntityId(4, 0)));
+			TestCheck(!restoreWith(healthIdsOffset, MakeEntityId(0, 1)));
+			TestCheck(!restoreWith(healthIdsOffset, MakeEntityId(1, 0)));
+			TestCheck(restored.GetComponentContainer<Health>()->GetSize() == 0);
+			TestCheck(!restored.HasComponent<Health>(MakeEntityId(1, 0)));
+
+			// Tag on the destroyed slot
+			TestCheck(!restoreWith(enemyBitsOffset, (uint64)0b10101));
+			TestCheck(restored.GetComponentContainer<Enemy>()->GetSize() == 0);
+			TestCheck(restoreWith(enemyBitsOffset, (uint64)0b1001));
+			TestCheck(restored.HasComponent<Enemy>(MakeEntityId(3, 0)));
+		}
+	}
+}
+
+int main()
+{
+	GameCore::Tests::TestRoundTrip();
+	GameCore::Tests::TestInvalidSnapshots();
+	GameCore::Tests::TestInvalidComponents();
+	return (int)GameCore::Tests::ourFailedChecksCount;
+}
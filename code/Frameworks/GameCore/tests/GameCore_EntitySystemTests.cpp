@@ -0,0 +1,102 @@
+#include "GameCore_Tests.h"
+#include "GameCore_EntitySystem.h"
+
+#include <mutex>
+
+namespace GameCore::Tests
+{
+	namespace
+	{
+		enum : uint
+		{
+			Position,
+			Velocity,
+			Health,
+		};
+
+		ComponentMask MakeMask(std::initializer_list<uint> someComponentIds)
+		{
+			ComponentMask mask;
+			for (uint componentId : someComponentIds)
+				mask.Set(componentId);
+			return mask;
+		}
+
+		// Records the order the systems ran in
+		struct RunLog
+		{
+			EntitySystemEntry MakeSystem(const std::string& aName, std::initializer_list<uint> someReads, std::initializer_list<uint> someWrites)
+			{
+				EntitySystemEntry system;
+				system.myName = aName;
+				system.myReads = MakeMask(someReads);
+				system.myWrites = MakeMask(someWrites);
+				system.myFunction = [this, aName]() {
+					std::lock_guard<std::mutex> lock(myMutex);
+					myNames.push_back(aName);
+				};
+				return system;
+			}
+
+			uint GetPosition(const std::string& aName) const
+			{
+				return (uint)(std::find(myNames.begin(), myNames.end(), aName) - myNames.begin());
+			}
+
+			std::mutex myMutex;
+			std::vector<std::string> myNames;
+		};
+
+		void TestConflictOrder(Thread::WorkerPool& aPool)
+		{
+			RunLog log;
+			EntitySystemScheduler scheduler;
+			scheduler.AddSystem(log.MakeSystem("Input", {}, { Velocity }));
+			scheduler.AddSystem(log.MakeSystem("Movement", { Velocity }, { Position }));
+			scheduler.AddSystem(log.MakeSystem("Damage", {}, { Health }));
+			scheduler.AddSystem(log.MakeSystem("Render", { Position, Health }, {}));
+			scheduler.Run(aPool);
+
+			TestCheck(log.myNames.size() == 4);
+			TestCheck(log.GetPosition("Input") < log.GetPosition("Movement"));
+			TestCheck(log.GetPosition("Movement") < log.GetPosition("Render"));
+			TestCheck(log.GetPosition("Damage") < log.GetPosition("Render"));
+		}
+
+		// Removing a system frees its id for the next one, which must still run after the systems added before it
+		void TestRegistrationOrder(Thread::WorkerPool& aPool)
+		{
+			RunLog log;
+			EntitySystemScheduler scheduler;
+			const uint firstId = scheduler.AddSystem(log.MakeSystem("First", {}, { Position }));
+			scheduler.AddSystem(log.MakeSystem("Second", {}, { Position }));
+			scheduler.AddSystem(log.MakeSystem("Third", { Position }, {}));
+			scheduler.Run(aPool);
+			TestCheck(log.myNames == std::vector<std::string>({ "First", "Second", "Third" }));
+
+			scheduler.RemoveSystem(firstId);
+			const uint lastId = scheduler.AddSystem(log.MakeSystem("Last", {}, { Position }));
+			TestCheck(lastId == firstId);
+
+			log.myNames.clear();
+			scheduler.Run(aPool);
+			TestCheck(log.myNames == std::vector<std::string>({ "Second", "Third", "Last" }));
+
+			const EntityScheduleTrace& trace = scheduler.GetLastTrace();
+			TestCheck(trace.mySystems.size() == 3 && trace.mySystems[2].myName == "Last");
+		}
+	}
+}
+
+int main()
+{
+	// Without workers everything runs on the calling thread, the pool caps the count to the CPUs
+	for (uint workersCount : { 0u, 1u, 4u, UINT_MAX })
+	{
+		Thread::WorkerPool pool;
+		pool.SetWorkersCount(workersCount);
+		GameCore::Tests::TestConflictOrder(pool);
+		GameCore::Tests::TestRegistrationOrder(pool);
+	}
+	return (int)GameCore::Tests::ourFailedChecksCount;
+}
@@ -0,0 +1,126 @@
+#include "GameCore_Tests.h"
+#include "GameCore_EntityModule.h"
+
+namespace GameCore::Tests
+{
+	namespace
+	{
+		struct Enemy {};
+		struct Frozen {};
+
+		struct Health
+		{
+			int myValue = 0;
+		};
+
+		void TestAddAndRemove()
+		{
+			EntityWorld world;
+			std::vector<EntityId> entities(200);
+			world.CreateMany(entities);
+			for (uint i = 0; i < (uint)entities.size(); i += 2)
+				TestCheck(world.AddComponent<Enemy>(entities[i]) != nullptr);
+			world.AddComponents<Enemy>(entities, Enemy());
+
+			const ComponentContainer<Enemy>* enemies = world.GetComponentContainer<Enemy>();
+			TestCheck(enemies->GetSize() == 200);
+			world.RemoveComponent<Enemy>(entities[3]);
+			world.RemoveComponent<Enemy>(entities[3]);
+			TestCheck(enemies->GetSize() == 199);
+			TestCheck(!world.HasComponent<Enemy>(entities[3]));
+			TestCheck(world.HasComponent<Enemy>(entities[4]));
+
+			world.Destroy(entities[4]);
+			TestCheck(enemies->GetSize() == 198);
+		}
+
+		// The slot of a destroyed entity is reused, its old id must not reach the new entity
+		void TestStaleIds()
+		{
+			EntityWorld world;
+			const EntityId oldId = world.Create();
+			world.Destroy(oldId);
+			const EntityId newId = world.Create();
+			TestCheck(GetEntityIndex(newId) == GetEntityIndex(oldId));
+
+			ComponentContainer<Enemy>* enemies = world.GetComponentContainer<Enemy>();
+			TestCheck(enemies->AddComponent(oldId) == nullptr);
+			const EntityId staleIds[] = { oldId };
+			enemies->AddComponents(staleIds, Enemy());
+			TestCheck(!world.HasComponent<Enemy>(newId));
+			TestCheck(enemies->GetSize() == 0);
+
+			world.AddComponent<Enemy>(newId);
+			enemies->RemoveComponent(oldId);
+			TestCheck(world.HasComponent<Enemy>(newId));
+			TestCheck(!world.HasComponent<Enemy>(oldId));
+			TestCheck(enemies->GetSize() == 1);
+		}
+
+		void TestReplaceEvents()
+		{
+			EntityWorld world;
+			const EntityId entityId = world.Create();
+			ComponentContainer<Enemy>* enemies = world.GetComponentContainer<Enemy>();
+			enemies->SetObservedEvent(ComponentEvent::Add, true);
+			enemies->SetObservedEvent(ComponentEvent::Replace, true);
+
+			std::vector<EntityId> events;
+			world.ReplaceComponent<Enemy>(entityId);
+			enemies->TakeEvents(ComponentEvent::Add, events);
+			TestCheck(events == std::vector<EntityId>({ entityId }));
+			enemies->TakeEvents(ComponentEvent::Replace, events);
+			TestCheck(events.empty());
+
+			world.ReplaceComponent<Enemy>(entityId);
+			enemies->TakeEvents(ComponentEvent::Add, events);
+			TestCheck(events.empty());
+			enemies->TakeEvents(ComponentEvent::Replace, events);
+			TestCheck(events == std::vector<EntityId>({ entityId }));
+		}
+
+		// Tags have no chunks, automatic shrinking must leave them alone
+		void TestNoUnusedChunks()
+		{
+			EntityWorld world;
+			for (uint i = 0; i < 1000; ++i)
+				world.AddComponent<Enemy>(world.Create());
+			TestCheck(!world.GetComponentContainer<Enemy>()->HasUnusedChunks(0));
+			TestCheck(!world.GetComponentContainer<Enemy>()->HasUnusedChunks(1));
+		}
+
+		void TestForEachTagged()
+		{
+			EntityWorld world;
+			std::vector<EntityId> entities(300);
+			world.CreateMany(entities);
+			for (uint i = 0; i < (uint)entities.size(); ++i)
+			{
+				world.AddComponent<Health>(entities[i], Health{ (int)i });
+				if (i % 3 == 0)
+					world.AddComponent<Enemy>(entities[i]);
+				if (i % 2 == 0)
+					world.AddComponent<Frozen>(entities[i]);
+			}
+
+			uint count = 0;
+			bool isValid = true;
+			world.ForEachTagged<Health>(With<Enemy>(), Without<Frozen>(), [&](EntityId, Health* aHealth) {
+				isValid &= aHealth->myValue % 3 == 0 && aHealth->myValue % 2 != 0;
+				count++;
+			});
+			TestCheck(isValid);
+			TestCheck(count == 50);
+		}
+	}
+}
+
+int main()
+{
+	GameCore::Tests::TestAddAndRemove();
+	GameCore::Tests::TestStaleIds();
+	GameCore::Tests::TestReplaceEvents();
+	GameCore::Tests::TestNoUnusedChunks();
+	GameCore::Tests::TestForEachTagged();
+	return (int)GameCore::Tests::ourFailedChecksCount;
+}
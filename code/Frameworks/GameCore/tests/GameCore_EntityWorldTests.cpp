@@ -0,0 +1,92 @@
+#include "GameCore_Tests.h"
+#include "GameCore_EntityModule.h"
+
+namespace GameCore::Tests
+{
+	namespace
+	{
+		struct Health
+		{
+			int myValue = 0;
+		};
+
+		void TestGenerations()
+		{
+			EntityWorld world;
+			const EntityId firstId = world.Create();
+			TestCheck(GetEntityIndex(firstId) == 0 && GetEntityGeneration(firstId) == 0);
+			world.AddComponent<Health>(firstId, 1);
+
+			world.Destroy(firstId);
+			TestCheck(!world.Exists(firstId));
+			TestCheck(!world.HasComponent<Health>(firstId));
+
+			// Same slot, next generation: the old id stays dead
+			const EntityId secondId = world.Create();
+			TestCheck(GetEntityIndex(secondId) == 0 && GetEntityGeneration(secondId) == 1);
+			TestCheck(world.Exists(secondId));
+			TestCheck(!world.Exists(firstId));
+			TestCheck(!world.HasComponent<Health>(secondId));
+
+			// Destroying a stale id leaves the new entity alone
+			world.AddComponent<Health>(secondId, 2);
+			world.Destroy(firstId);
+			TestCheck(world.Exists(secondId));
+			TestCheck(world.GetComponent<Health>(secondId)->myValue == 2);
+		}
+
+		// Generations wrap around, skipping the one reserved for the ids of command buffers
+		void TestGenerationWrap()
+		{
+			EntityWorld world;
+			EntityId entityId = world.Create();
+			bool isValid = true;
+			for (uint i = 0; i < ourEntityGenerationMask + 2; ++i)
+			{
+				world.Destroy(entityId);
+				const EntityId newId = world.Create();
+				isValid &= GetEntityIndex(newId) == 0 && newId != entityId;
+				isValid &= GetEntityGeneration(newId) != ourDeferredEntityGeneration;
+				entityId = newId;
+			}
+			TestCheck(isValid);
+			TestCheck(GetEntityGeneration(entityId) == 2);
+		}
+
+		// Freed slots are reused in the order they were freed, so that a slot stays unused as long as possible
+		void TestFreeListOrder()
+		{
+			EntityWorld world;
+			std::vector<EntityId> entities(8);
+			world.CreateMany(entities);
+			for (uint i = 0; i < (uint)entities.size(); ++i)
+				TestCheck(entities[i] == MakeEntityId(i, 0));
+
+			world.Destroy(entities[5]);
+			world.Destroy(entities[2]);
+			world.Destroy(entities[6]);
+			TestCheck(world.Create() == MakeEntityId(5, 1));
+			TestCheck(world.Create() == MakeEntityId(2, 1));
+
+			// Bulk creation takes the free slots first, then grows
+			std::vector<EntityId> moreEntities(3);
+			world.CreateMany(moreEntities);
+			TestCheck(moreEntities[0] == MakeEntityId(6, 1));
+			TestCheck(moreEntities[1] == MakeEntityId(8, 0));
+			TestCheck(moreEntities[2] == MakeEntityId(9, 0));
+
+			uint aliveCount = 0;
+			for (uint i = 0; i < 10; ++i)
+				aliveCount += world.Exists(MakeEntityId(i, 0)) || world.Exists(MakeEntityId(i, 1)) ? 1 : 0;
+			TestCheck(aliveCount == 10);
+		}
+	}
+}
+
+int main()
+{
+	GameCore::Tests::TestGenerations();
+	GameCore::Tests::TestGenerationWrap();
+	GameCore::Tests::TestFreeListOrder();
+	return (int)GameCore::Tests::ourFailedChecksCount;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "GameCore_Defines.h"
+#include "GameCore_Assert.h"
+#include "GameCore_glm.h"
+#include "GameCore_Utils.h"
+
+#include <cstdio>
+
+namespace GameCore::Tests
+{
+	inline uint ourFailedChecksCount = 0;
+
+	// Reports a failed check and carries on, the test returns the number of failed checks
+	inline void Check(bool aCondition, const char* aConditionText, const char* aFile, int aLine)
+	{
+		if (aCondition)
+			return;
+
+		std::fprintf(stderr, "%s(%d): check failed: %s\n", aFile, aLine, aConditionText);
+		ourFailedChecksCount++;
+	}
+}
+
+#define TestCheck(X) GameCore::Tests::Check((X), #X, __FILE__, __LINE__)
@@ -0,0 +1,126 @@
+#include "GameCore_Tests.h"
+#include "GameCore_ThreadAlgorithms.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+namespace GameCore::Tests
+{
+	namespace
+	{
+		// The index tells whether equal keys kept their order
+		struct Element
+		{
+			uint64 myKey = 0;
+			uint myIndex = 0;
+
+			bool operator==(const Element& anOther) const { return myKey == anOther.myKey && myIndex == anOther.myIndex; }
+		};
+
+		// aKeyRange small compared to aCount gives many equal keys
+		std::vector<Element> MakeElements(uint aCount, uint64 aKeyRange, uint aSeed)
+		{
+			std::mt19937_64 random(aSeed);
+			std::vector<Element> elements(aCount);
+			for (uint i = 0; i < aCount; ++i)
+				elements[i] = { random() % aKeyRange, i };
+			return elements;
+		}
+
+		std::vector<Element> SortReference(std::vector<Element> someElements)
+		{
+			std::stable_sort(someElements.begin(), someElements.end(), [](const Element& aLeft, const Element& aRight) { return aLeft.myKey < aRight.myKey; });
+			return someElements;
+		}
+
+		// Small grain sizes, so that even small arrays are split in many runs and chunks
+		void TestSorts(Thread::WorkerPool& aPool)
+		{
+			const uint counts[] = { 0, 1, 2, 3, 17, 1000, 4099, 100000 };
+			const uint64 keyRanges[] = { 1, 7, 1000, UINT64_MAX };
+			uint seed = 1;
+			for (uint count : counts)
+			{
+				for (uint64 keyRange : keyRanges)
+				{
+					const std::vector<Element> elements = MakeElements(count, keyRange, seed++);
+					const std::vector<Element> expected = SortReference(elements);
+
+					std::vector<Element> sorted = elements;
+					Thread::ParallelSort(aPool, sorted.data(), count, [](const Element& aLeft, const Element& aRight) { return aLeft.myKey < aRight.myKey; }, 16);
+					TestCheck(sorted == expected);
+
+					sorted = elements;
+					Thread::ParallelRadixSort(aPool, sorted.data(), count, [](const Element& anElement) { return anElement.myKey; }, 16);
+					TestCheck(sorted == expected);
+
+					// Default grain sizes
+					sorted = elements;
+					Thread::ParallelSort(aPool, sorted.data(), count, [](const Element& aLeft, const Element& aRight) { return aLeft.myKey < aRight.myKey; });
+					TestCheck(sorted == expected);
+				}
+			}
+
+			// Narrow keys, compared with std::sort on plain values
+			std::mt19937 random(42);
+			std::vector<uint> values(50000);
+			for (uint& value : values)
+				value = random();
+			std::vector<uint> expected = values;
+			std::sort(expected.begin(), expected.end());
+
+			std::vector<uint> sorted = values;
+			Thread::ParallelSort(aPool, sorted.data(), (uint)sorted.size());
+			TestCheck(sorted == expected);
+
+			sorted = values;
+			Thread::ParallelRadixSort(aPool, sorted.data(), (uint)sorted.size(), [](uint aValue) { return aValue; });
+			TestCheck(sorted == expected);
+
+			// Descending order
+			std::sort(expected.begin(), expected.end(), std::greater<>());
+			sorted = values;
+			Thread::ParallelSort(aPool, sorted.data(), (uint)sorted.size(), std::greater<>(), 64);
+			TestCheck(sorted == expected);
+		}
+
+		void TestScansAndReduce(Thread::WorkerPool& aPool)
+		{
+			const uint count = 10007;
+			std::vector<uint64> values(count);
+			for (uint i = 0; i < count; ++i)
+				values[i] = i * 3 + 1;
+
+			std::vector<uint64> expected(count);
+			std::inclusive_scan(values.begin(), values.end(), expected.begin(), std::plus<>(), (uint64)5);
+			std::vector<uint64> scanned(count);
+			Thread::ParallelInclusiveScan(aPool, values.data(), scanned.data(), count, (uint64)5, std::plus<>(), 64);
+			TestCheck(scanned == expected);
+
+			std::exclusive_scan(values.begin(), values.end(), expected.begin(), (uint64)5);
+			Thread::ParallelExclusiveScan(aPool, values.data(), scanned.data(), count, (uint64)5, std::plus<>(), 64);
+			TestCheck(scanned == expected);
+
+			const uint64 sum = Thread::ParallelReduce(aPool, 0, count, (uint64)0, [&values](uint aBegin, uint anEnd, uint64 aSum) {
+				for (uint i = aBegin; i < anEnd; ++i)
+					aSum += values[i];
+				return aSum;
+			}, std::plus<>(), 64);
+			TestCheck(sum == std::accumulate(values.begin(), values.end(), (uint64)0));
+		}
+	}
+}
+
+int main()
+{
+	// Without workers everything runs on the calling thread, the pool caps the count to the CPUs
+	for (uint workersCount : { 0u, 1u, 4u, UINT_MAX })
+	{
+		Thread::WorkerPool pool;
+		pool.SetWorkersCount(workersCount);
+		GameCore::Tests::TestSorts(pool);
+		GameCore::Tests::TestScansAndReduce(pool);
+	}
+	return (int)GameCore::Tests::ourFailedChecksCount;
+}
@@ -0,0 +1,415 @@
+#include "GameCore_Tests.h"
+#include "GameCore_Thread.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+namespace GameCore::Tests
+{
+	namespace
+	{
+		// Records the order the jobs ran in
+		struct RunLog
+		{
+			void Add(uint aValue)
+			{
+				std::lock_guard<std::mutex> lock(myMutex);
+				myValues.push_back(aValue);
+			}
+
+			std::mutex myMutex;
+			std::vector<uint> myValues;
+		};
+
+		// The owner pops the last pushed job, thieves take the oldest one
+		void TestDequeOrder()
+		{
+			std::unique_ptr<Thread::JobData[]> jobs = std::make_unique<Thread::JobData[]>(200);
+			Thread::JobDeque deque;
+			TestCheck(deque.IsEmpty() && !deque.Pop() && !deque.Steal());
+
+			// Past the initial capacity
+			for (uint i = 0; i < 200; ++i)
+				deque.Push(&jobs[i]);
+			TestCheck(deque.Pop() == &jobs[199]);
+			TestCheck(deque.Steal() == &jobs[0]);
+			TestCheck(deque.Steal() == &jobs[1]);
+			TestCheck(deque.Pop() == &jobs[198]);
+
+			uint count = 4;
+			while (deque.Pop())
+				count++;
+			TestCheck(count == 200);
+			TestCheck(deque.IsEmpty() && !deque.Steal());
+		}
+
+		// Each job is taken exactly once, by the owner or by one of the thieves
+		void TestDequeSteals()
+		{
+			constexpr uint jobsCount = 100000;
+			std::unique_ptr<Thread::JobData[]> jobs = std::make_unique<Thread::JobData[]>(jobsCount);
+			std::unique_ptr<std::atomic<uint>[]> takenCounts = std::make_unique<std::atomic<uint>[]>(jobsCount);
+			Thread::JobDeque deque;
+			std::atomic<bool> isDone = false;
+
+			auto take = [&](Thread::JobData* aJob) { takenCounts[aJob - jobs.get()]++; };
+			std::vector<std::thread> thieves;
+			for (uint i = 0; i < 3; ++i)
+			{
+				thieves.emplace_back([&] {
+					while (!isDone)
+					{
+						if (Thread::JobData* job = deque.Steal())
+							take(job);
+					}
+				});
+			}
+
+			for (uint i = 0; i < jobsCount; ++i)
+			{
+				deque.Push(&jobs[i]);
+				if (i % 3 == 0)
+				{
+					if (Thread::JobData* job = deque.Pop())
+						take(job);
+				}
+			}
+			while (Thread::JobData* job = deque.Pop())
+				take(job);
+
+			// The thieves may still hold the last jobs they stole
+			isDone = true;
+			for (std::thread& thief : thieves)
+				thief.join();
+
+			bool isValid = true;
+			for (uint i = 0; i < jobsCount; ++i)
+				isValid &= takenCounts[i] == 1;
+			TestCheck(isValid);
+		}
+
+		// Jobs requested from jobs go to the deque of their worker, and are stolen from there
+		void TestNestedJobs(Thread::WorkerPool& aPool)
+		{
+			std::atomic<uint> doneCount = 0;
+			for (uint i = 0; i < 64; ++i)
+			{
+				aPool.RequestJob([&aPool, &doneCount] {
+					for (uint j = 0; j < 64; ++j)
+						aPool.RequestJob([&doneCount] { doneCount++; });
+				});
+			}
+			aPool.WaitIdle();
+			TestCheck(doneCount == 64 * 64);
+		}
+
+		// Pinned jobs all run on their worker
+		void TestPinnedJobs(Thread::WorkerPool& aPool)
+		{
+			if (aPool.GetWorkersCount() == 0)
+				return;
+
+			std::mutex mutex;
+			std::vector<std::thread::id> threads;
+			for (uint i = 0; i < 20; ++i)
+			{
+				aPool.RequestJob([&mutex, &threads] {
+					std::lock_guard<std::mutex> lock(mutex);
+					threads.push_back(std::this_thread::get_id());
+				}, aPool.GetWorkersCount() - 1);
+			}
+			aPool.WaitIdle();
+			TestCheck(threads.size() == 20);
+			TestCheck(!threads.empty() && std::count(threads.begin(), threads.end(), threads[0]) == 20);
+			TestCheck(!threads.empty() && threads[0] != std::this_thread::get_id());
+		}
+
+		// More jobs in flight than a block holds
+		void TestManyJobs(Thread::WorkerPool& aPool)
+		{
+			std::atomic<uint> doneCount = 0;
+			std::vector<Thread::JobHandle> jobs;
+			for (uint i = 0; i < 5000; ++i)
+				jobs.push_back(aPool.RequestJob([&doneCount] { doneCount++; }));
+			for (const Thread::JobHandle& job : jobs)
+				aPool.WaitForJob(job);
+			TestCheck(doneCount == 5000);
+
+			bool areDone = true;
+			for (const Thread::JobHandle& job : jobs)
+				areDone &= job.IsDone();
+			TestCheck(areDone);
+		}
+
+		// What the functions capture is released once they ran, inline or not
+		void TestJobFunctions(Thread::WorkerPool& aPool)
+		{
+			std::shared_ptr<uint> value = std::make_shared<uint>(0);
+			std::array<uint, 32> largeCapture = {};
+			largeCapture[31] = 2;
+			Thread::JobHandle smallJob = aPool.RequestJob([value] { (*value)++; });
+			Thread::JobHandle largeJob = aPool.RequestJob([value, largeCapture] { (*value) += largeCapture[31]; });
+			aPool.WaitForJob(smallJob);
+			aPool.WaitForJob(largeJob);
+			TestCheck(*value == 3);
+			TestCheck(value.use_count() == 1);
+
+			// Copies of a handle keep the job until the last one is reset
+			Thread::JobHandle copy = smallJob;
+			smallJob.Reset();
+			TestCheck(!smallJob && copy && copy.IsDone());
+			Thread::JobHandle moved = std::move(copy);
+			TestCheck(!copy && moved.IsDone());
+		}
+
+		uint ComputeFibonacci(Thread::WorkerPool& aPool, uint aValue)
+		{
+			if (aValue < 2)
+				return aValue;
+
+			uint first = 0;
+			uint second = 0;
+			Thread::JobHandle firstJob = aPool.RequestJob([&aPool, &first, aValue] { first = ComputeFibonacci(aPool, aValue - 1); });
+			Thread::JobHandle secondJob = aPool.RequestJob([&aPool, &second, aValue] { second = ComputeFibonacci(aPool, aValue - 2); });
+			aPool.WaitForJob(firstJob);
+			aPool.WaitForJob(secondJob);
+			return first + second;
+		}
+
+		// Jobs waiting for the jobs they requested run them meanwhile, even a single worker gets through
+		void TestWaitsFromJobs(Thread::WorkerPool& aPool)
+		{
+			uint result = 0;
+			aPool.WaitForJob(aPool.RequestJob([&aPool, &result] { result = ComputeFibonacci(aPool, 12); }));
+			TestCheck(result == 144);
+		}
+
+		// Waiting for a frame critical job doesn't start a background job, while a worker is free to take it
+		void TestWaitPriority(Thread::WorkerPool& aPool)
+		{
+			if (aPool.GetWorkersCount() == 0)
+				return;
+
+			std::atomic<bool> isReleased = false;
+			std::atomic<bool> isBlocking = false;
+			Thread::JobHandle blockingJob = aPool.RequestJob([&isReleased, &isBlocking] {
+				isBlocking = true;
+				while (!isReleased)
+					std::this_thread::yield();
+			});
+			while (!isBlocking)
+				std::this_thread::yield();
+
+			const std::thread::id waitingThread = std::this_thread::get_id();
+			std::atomic<bool> isWaiting = false;
+			bool ranDuringWait = false;
+			Thread::JobHandle backgroundJob = aPool.RequestJob([&] {
+				ranDuringWait = isWaiting && std::this_thread::get_id() == waitingThread;
+			}, Thread::JobPriority::Background);
+
+			// Queued once the group is closed, the wait has nothing to run until then
+			Thread::JobHandle group = aPool.CreateJobGroup(Thread::JobPriority::FrameCritical);
+			Thread::JobHandle criticalJob = aPool.RequestJob([] {}, { group }, Thread::JobPriority::FrameCritical);
+			std::thread closingThread([&aPool, &group] {
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				aPool.CloseJobGroup(group);
+			});
+			isWaiting = true;
+			aPool.WaitForJob(criticalJob);
+			isWaiting = false;
+			closingThread.join();
+
+			isReleased = true;
+			aPool.WaitIdle();
+			TestCheck(backgroundJob.IsDone());
+			TestCheck(!ranDuringWait);
+		}
+
+		// Jobs requested while the only worker is busy, then run by it alone: the calling thread polls instead of helping
+		struct LanesLog
+		{
+			LanesLog()
+			{
+				myPool.SetWorkersCount(1);
+				myBlockingJob = myPool.RequestJob([this] {
+					while (!myIsReleased)
+						std::this_thread::yield();
+				});
+			}
+
+			void Request(Thread::JobPriority aPriority)
+			{
+				myRequestedCount++;
+				myPool.RequestJob([this, aPriority] {
+					myPriorities.push_back(myPool.GetCurrentJobPriority());
+					myIsCurrentPriorityValid &= myPool.GetCurrentJobPriority() == aPriority;
+					myDoneCount++;
+				}, aPriority);
+			}
+
+			void Run()
+			{
+				myIsReleased = true;
+				while (myDoneCount < myRequestedCount)
+					std::this_thread::yield();
+				myPool.WaitIdle();
+			}
+
+			Thread::WorkerPool myPool;
+			Thread::JobHandle myBlockingJob;
+			std::atomic<bool> myIsReleased = false;
+			std::atomic<uint> myDoneCount = 0;
+			uint myRequestedCount = 0;
+			// Only written by the worker, read once it is done
+			std::vector<Thread::JobPriority> myPriorities;
+			bool myIsCurrentPriorityValid = true;
+		};
+
+		void TestLanes()
+		{
+			LanesLog log;
+			if (log.myPool.GetWorkersCount() == 0)
+				return;
+
+			for (uint i = 0; i < 8; ++i)
+			{
+				log.Request(Thread::JobPriority::Background);
+				log.Request(Thread::JobPriority::Normal);
+				log.Request(Thread::JobPriority::FrameCritical);
+			}
+			log.Run();
+
+			TestCheck(log.myIsCurrentPriorityValid);
+			TestCheck(std::is_sorted(log.myPriorities.begin(), log.myPriorities.end()));
+			TestCheck(log.myPool.GetCurrentJobPriority() == Thread::JobPriority::Normal);
+		}
+
+		// Background jobs still get a turn while other lanes keep being busy
+		void TestBackgroundStarvation()
+		{
+			LanesLog log;
+			if (log.myPool.GetWorkersCount() == 0)
+				return;
+
+			log.Request(Thread::JobPriority::Background);
+			for (uint i = 0; i < 100; ++i)
+				log.Request(Thread::JobPriority::Normal);
+			log.Run();
+
+			const uint position = (uint)(std::find(log.myPriorities.begin(), log.myPriorities.end(), Thread::JobPriority::Background) - log.myPriorities.begin());
+			TestCheck(position > 0 && position < 50);
+		}
+
+		void TestContinuations(Thread::WorkerPool& aPool)
+		{
+			RunLog log;
+			Thread::JobHandle first = aPool.RequestJob([&log] { log.Add(0); });
+			Thread::JobHandle second = aPool.RequestContinuation(first, [&log] { log.Add(1); });
+			Thread::JobHandle third = aPool.RequestContinuation(second, [&log] { log.Add(2); });
+			aPool.WaitForJob(third);
+			TestCheck(first.IsDone() && second.IsDone());
+			TestCheck(log.myValues == std::vector<uint>({ 0, 1, 2 }));
+
+			// Depending on jobs that are already done queues right away
+			Thread::JobHandle late = aPool.RequestJob([&log] { log.Add(3); }, { first, third });
+			aPool.WaitForJob(late);
+			TestCheck(log.myValues.back() == 3);
+		}
+
+		void TestDependencies(Thread::WorkerPool& aPool)
+		{
+			std::atomic<uint> doneCount = 0;
+			std::vector<Thread::JobHandle> jobs;
+			for (uint i = 0; i < 64; ++i)
+				jobs.push_back(aPool.RequestJob([&doneCount] { doneCount++; }));
+
+			uint seenCount = 0;
+			Thread::JobHandle joined = aPool.RequestJob([&doneCount, &seenCount] { seenCount = doneCount; }, std::span<const Thread::JobHandle>(jobs));
+			aPool.WaitForJob(joined);
+			TestCheck(seenCount == 64);
+		}
+
+		void TestJobGroups(Thread::WorkerPool& aPool)
+		{
+			std::atomic<uint> doneCount = 0;
+			uint seenCount = 0;
+			Thread::JobHandle group = aPool.CreateJobGroup();
+			Thread::JobHandle dependent = aPool.RequestJob([&doneCount, &seenCount] { seenCount = doneCount; }, { group });
+			std::vector<Thread::JobHandle> jobs;
+			for (uint i = 0; i < 50; ++i)
+			{
+				jobs.push_back(aPool.RequestJob([&doneCount] { doneCount++; }));
+				aPool.AddToJobGroup(group, jobs.back());
+			}
+
+			// Not done before it is closed, even once its jobs are
+			for (const Thread::JobHandle& job : jobs)
+				aPool.WaitForJob(job);
+			TestCheck(!group.IsDone());
+			TestCheck(!dependent.IsDone());
+
+			aPool.CloseJobGroup(group);
+			aPool.WaitForJob(dependent);
+			TestCheck(group.IsDone());
+			TestCheck(seenCount == 50);
+
+			// An empty group is done once closed
+			Thread::JobHandle emptyGroup = aPool.CreateJobGroup();
+			aPool.CloseJobGroup(emptyGroup);
+			TestCheck(emptyGroup.IsDone());
+		}
+
+		// A group of the pool is open while its pending job waits for a job of another pool: WaitIdle must not take it for a stall
+		void TestCrossPoolDependencies(Thread::WorkerPool& aPool)
+		{
+			Thread::WorkerPool otherPool;
+			otherPool.SetWorkersCount(1);
+
+			std::atomic<bool> isOtherDone = false;
+			Thread::JobHandle otherJob = otherPool.RequestJob([&isOtherDone] {
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				isOtherDone = true;
+			});
+
+			bool sawOtherDone = false;
+			Thread::JobHandle group = aPool.CreateJobGroup();
+			Thread::JobHandle job = aPool.RequestJob([&isOtherDone, &sawOtherDone] { sawOtherDone = isOtherDone; }, { otherJob });
+			aPool.WaitIdle();
+			TestCheck(job.IsDone());
+			TestCheck(sawOtherDone);
+
+			aPool.CloseJobGroup(group);
+			aPool.WaitIdle();
+			TestCheck(group.IsDone());
+		}
+	}
+}
+
+int main()
+{
+	GameCore::Tests::TestDequeOrder();
+	GameCore::Tests::TestDequeSteals();
+	GameCore::Tests::TestLanes();
+	GameCore::Tests::TestBackgroundStarvation();
+
+	// Without workers everything runs on the calling thread, the pool caps the count to the CPUs
+	for (uint workersCount : { 0u, 1u, 4u, UINT_MAX })
+	{
+		Thread::WorkerPool pool;
+		pool.SetWorkersCount(workersCount);
+		GameCore::Tests::TestNestedJobs(pool);
+		GameCore::Tests::TestPinnedJobs(pool);
+		GameCore::Tests::TestManyJobs(pool);
+		GameCore::Tests::TestJobFunctions(pool);
+		GameCore::Tests::TestWaitsFromJobs(pool);
+		GameCore::Tests::TestWaitPriority(pool);
+		GameCore::Tests::TestContinuations(pool);
+		GameCore::Tests::TestDependencies(pool);
+		GameCore::Tests::TestJobGroups(pool);
+		GameCore::Tests::TestCrossPoolDependencies(pool);
+	}
+	return (int)GameCore::Tests::ourFailedChecksCount;
+}
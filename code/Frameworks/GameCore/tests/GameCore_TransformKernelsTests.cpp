@@ -0,0 +1,102 @@
+#include "GameCore_Tests.h"
+#include "GameCore_TransformKernels.h"
+
+#include <random>
+
+namespace GameCore::Tests
+{
+	namespace
+	{
+		bool IsNear(const glm::mat4& aValue, const glm::mat4& anExpected)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				if (glm::any(glm::greaterThan(glm::abs(aValue[column] - anExpected[column]), glm::vec4(0.0001f))))
+					return false;
+			}
+			return true;
+		}
+
+		struct Transforms
+		{
+			Transforms(uint aCount, uint aSeed)
+			{
+				std::mt19937 random(aSeed);
+				std::uniform_real_distribution<float> values(-10.0f, 10.0f);
+				std::uniform_real_distribution<float> scales(0.1f, 4.0f);
+				for (uint i = 0; i < aCount; ++i)
+				{
+					myPositions.emplace_back(values(random), values(random), values(random));
+					myOrientations.push_back(glm::normalize(glm::quat(values(random), values(random), values(random), values(random))));
+					myScales.emplace_back(scales(random), scales(random), scales(random));
+				}
+			}
+
+			std::vector<glm::vec3> myPositions;
+			std::vector<glm::quat> myOrientations;
+			std::vector<glm::vec3> myScales;
+		};
+
+		// Counts around the SSE and AVX widths, so that the remainders go through the scalar loop
+		void TestAffineMatrices()
+		{
+			for (uint count = 0; count <= 37; ++count)
+			{
+				const Transforms transforms(count, count);
+				std::vector<AffineMatrix> matrices(count);
+				TransformKernels::ComputeAffineMatrices(transforms.myPositions.data(), transforms.myOrientations.data(), transforms.myScales.data(), count, matrices.data());
+
+				bool isValid = true;
+				for (uint i = 0; i < count; ++i)
+				{
+					const glm::mat4 reference = glm::translate(glm::mat4(1.0f), transforms.myPositions[i]) * glm::mat4_cast(transforms.myOrientations[i]) * glm::scale(glm::mat4(1.0f), transforms.myScales[i]);
+					isValid &= IsNear(matrices[i].ToMat4(), reference);
+					isValid &= IsNear(TransformKernels::ComputeAffineMatrix(transforms.myPositions[i], transforms.myOrientations[i], transforms.myScales[i]).ToMat4(), reference);
+				}
+				TestCheck(isValid);
+			}
+		}
+
+		void TestNormalMatrices()
+		{
+			for (uint count = 0; count <= 37; ++count)
+			{
+				const Transforms transforms(count, count + 100);
+				std::vector<AffineMatrix> matrices(count);
+				TransformKernels::ComputeNormalMatrices(transforms.myOrientations.data(), transforms.myScales.data(), count, matrices.data());
+
+				bool isValid = true;
+				for (uint i = 0; i < count; ++i)
+				{
+					const glm::mat3 model = glm::mat3_cast(transforms.myOrientations[i]) * glm::mat3(glm::scale(glm::mat4(1.0f), transforms.myScales[i]));
+					const glm::mat4 reference = glm::mat4(glm::transpose(glm::inverse(model)));
+					isValid &= IsNear(matrices[i].ToMat4(), reference);
+				}
+				TestCheck(isValid);
+			}
+		}
+
+		// The batch output must not depend on where the batch starts
+		void TestUnalignedBatches()
+		{
+			const Transforms transforms(40, 7);
+			std::vector<AffineMatrix> matrices(40);
+			TransformKernels::ComputeAffineMatrices(transforms.myPositions.data(), transforms.myOrientations.data(), transforms.myScales.data(), 40, matrices.data());
+
+			std::vector<AffineMatrix> offsetMatrices(37);
+			TransformKernels::ComputeAffineMatrices(transforms.myPositions.data() + 3, transforms.myOrientations.data() + 3, transforms.myScales.data() + 3, 37, offsetMatrices.data());
+			bool isValid = true;
+			for (uint i = 0; i < 37; ++i)
+				isValid &= IsNear(offsetMatrices[i].ToMat4(), matrices[i + 3].ToMat4());
+			TestCheck(isValid);
+		}
+	}
+}
+
+int main()
+{
+	GameCore::Tests::TestAffineMatrices();
+	GameCore::Tests::TestNormalMatrices();
+	GameCore::Tests::TestUnalignedBatches();
+	return (int)GameCore::Tests::ourFailedChecksCount;
+}
@@ -58,16 +58,23 @@ void RhythmShooterModule::OnUpdate(GameCore::Module::UpdateType aType)
 {
 	if (aType == GameCore::Module::UpdateType::MainUpdate)
 	{
-		if (GameCore::Entity3DTransformComponent* component = myTestModel.GetComponent<GameCore::Entity3DTransformComponent>())
+		GameCore::InputModule* inputModule = GameCore::InputModule::GetInstance();
+		const bool shouldRotate = inputModule->PollKeyInput(Input::KeyR) == Input::Status::Pressed;
+		const bool shouldScale = inputModule->PollKeyInput(Input::KeyE) == Input::Status::Pressed;
+
+		// Getting the component marks it as changed, only do it when it is modified
+		if (shouldRotate || shouldScale)
 		{
-			GameCore::InputModule* inputModule = GameCore::InputModule::GetInstance();
-			if (inputModule->PollKeyInput(Input::KeyR) == Input::Status::Pressed)
-			{
-				component->Rotate(0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
-			}
-			if (inputModule->PollKeyInput(Input::KeyE) == Input::Status::Pressed)
+			if (GameCore::Entity3DTransformComponent* component = myTestModel.GetComponent<GameCore::Entity3DTransformComponent>())
 			{
-				component->Scale(glm::vec3(1.01f, 1.0f, 0.99f));
+				if (shouldRotate)
+				{
+					component->Rotate(0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+				}
+				if (shouldScale)
+				{
+					component->Scale(glm::vec3(1.01f, 1.0f, 0.99f));
+				}
 			}
 		}
 	}
@@ -6,6 +6,13 @@
 
 namespace Render
 {
+	EntityModelComponent::EntityModelComponent(EntityModelComponent&& anOther)
+		: myIsTransparent(anOther.myIsTransparent)
+		, myModel(anOther.myModel)
+	{
+		anOther.myModel = nullptr;
+	}
+
 	EntityModelComponent::~EntityModelComponent()
 	{
 		Unload();
@@ -16,7 +23,7 @@ namespace Render
 		SafeDelete(myModel);
 	}
 
-	void EntityModelComponent::Update(const glm::mat4& aMatrix)
+	void EntityModelComponent::Update(const glm::mat4& aMatrix) const
 	{
 		myModel->Update(aMatrix);
 	}
@@ -446,6 +453,12 @@ namespace Render
 	{
 	}
 
+	EntityGuiComponent::EntityGuiComponent(EntityGuiComponent&& anOther)
+		: myGui(anOther.myGui)
+	{
+		anOther.myGui = nullptr;
+	}
+
 	EntityGuiComponent::~EntityGuiComponent()
 	{
 		Unload();
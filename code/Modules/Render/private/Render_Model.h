@@ -10,6 +10,8 @@ namespace Render
 	public:
 		virtual ~Model() {};
 		virtual void Update(const glm::mat4& aMatrix) = 0;
+		// Animated models advance their animation in Update, so they need to be updated every frame
+		virtual bool IsAnimated() const { return false; }
 		virtual void Draw(VkCommandBuffer aCommandBuffer, VkPipelineLayout aPipelineLayout, uint aDescriptorSetIndex, ShaderHelpers::BindType aType) = 0;
 	};
 
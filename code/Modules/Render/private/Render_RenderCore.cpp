@@ -4,8 +4,10 @@
 #include "Render_VulkanDevice.h"
 #include "Render_SwapChain.h"
 #include "Render_Resource.h"
+#include "Render_Model.h"
 
 #include "GameCore_EntityCameraComponent.h"
+#include "GameCore_EntityHierarchyComponent.h"
 #include "GameCore_EntityTransformComponent.h"
 
 #include <GLFW/glfw3.h>
@@ -21,6 +23,84 @@ namespace Render
 #else
 		constexpr bool locEnableValidationLayers = false;
 #endif
+
+		// Components get their model once loaded, they are neither static nor animated until then
+		template<typename ModelComponent>
+		bool IsStaticModel(const ModelComponent* aModel)
+		{
+			return aModel && aModel->GetModel() && !aModel->GetModel()->IsAnimated();
+		}
+
+		template<typename ModelComponent>
+		bool IsAnimatedModel(const ModelComponent* aModel)
+		{
+			return aModel && aModel->GetModel() && aModel->GetModel()->IsAnimated();
+		}
+
+		// Static models are only updated when their transform changed or when they were added since aTick
+		// Animated models are updated exactly once per frame, as updating them advances their animation
+		// Models that are part of a hierarchy use its world matrix, recomputed by the EntityModule when any ancestor moved
+		template<typename ModelComponent>
+		void UpdateModels(uint aTick)
+		{
+			GameCore::EntityModule* entityModule = GameCore::EntityModule::GetInstance();
+			GameCore::ComponentContainer<ModelComponent>* models = entityModule->GetComponentContainer<ModelComponent>();
+			GameCore::ComponentContainer<GameCore::Entity3DTransformComponent>* transforms = entityModule->GetComponentContainer<GameCore::Entity3DTransformComponent>();
+			GameCore::ComponentContainer<GameCore::EntityHierarchyComponent>* hierarchies = entityModule->GetComponentContainer<GameCore::EntityHierarchyComponent>();
+			const GameCore::ComponentContainer<ModelComponent>& constModels = *models;
+			const GameCore::ComponentContainer<GameCore::Entity3DTransformComponent>& constTransforms = *transforms;
+			const GameCore::ComponentContainer<GameCore::EntityHierarchyComponent>& constHierarchies = *hierarchies;
+
+			// Static models outside of hierarchies get their matrices computed in one batch
+			std::vector<const ModelComponent*> staticModels;
+			std::vector<glm::vec3> positions;
+			std::vector<glm::quat> orientations;
+			std::vector<glm::vec3> scales;
+			auto addStaticModel = [&](const ModelComponent* aModel, const GameCore::Entity3DTransformComponent* aTransform) {
+				staticModels.push_back(aModel);
+				positions.push_back(aTransform->GetPosition());
+				orientations.push_back(aTransform->GetOrientation());
+				scales.push_back(aTransform->GetScale());
+			};
+
+			transforms->ForEachChangedSince(aTick, [&](GameCore::EntityId anId, GameCore::Entity3DTransformComponent* aTransform) {
+				const ModelComponent* model = constModels.GetComponent(anId);
+				if (IsStaticModel(model) && !constHierarchies.HasComponent(anId))
+					addStaticModel(model, aTransform);
+			});
+
+			hierarchies->ForEachChangedSince(aTick, [&constModels](GameCore::EntityId anId, GameCore::EntityHierarchyComponent* aNode) {
+				const ModelComponent* model = constModels.GetComponent(anId);
+				if (IsStaticModel(model))
+					model->Update(aNode->GetWorldMatrix());
+			});
+
+			models->ForEachChangedSince(aTick, [&](GameCore::EntityId anId, ModelComponent* aModel) {
+				if (!IsStaticModel(aModel))
+					return;
+
+				if (const GameCore::EntityHierarchyComponent* node = constHierarchies.GetComponent(anId))
+					aModel->Update(node->GetWorldMatrix());
+				else if (const GameCore::Entity3DTransformComponent* transform = constTransforms.GetComponent(anId))
+				{
+					// Already added if its transform changed too
+					if (!constTransforms.HasChangedSince(anId, aTick))
+						addStaticModel(aModel, transform);
+				}
+			});
+
+			std::vector<GameCore::AffineMatrix> matrices(staticModels.size());
+			GameCore::TransformKernels::ComputeAffineMatrices(positions.data(), orientations.data(), scales.data(), (uint)staticModels.size(), matrices.data());
+			for (uint i = 0; i < (uint)staticModels.size(); ++i)
+				staticModels[i]->Update(matrices[i].ToMat4());
+
+			for (auto it = models->begin(), end = models->end(); it != end; ++it)
+			{
+				ModelComponent* model = *it;
+				if (IsAnimatedModel(model) && (constTransforms.HasComponent(it.GetEntityId()) || constHierarchies.HasComponent(it.GetEntityId())))
+					model->Update(entityModule->GetWorldMatrix(it.GetEntityId()));
+			}
+		}
 	}
 
 	RenderCore::RenderCore()
@@ -82,25 +162,9 @@ namespace Render
 
 	void RenderCore::Update()
 	{
-		{
-			GameCore::ComponentContainer<EntitySimpleGeometryModelComponent>* container = GameCore::EntityModule::GetInstance()->GetComponentContainer<EntitySimpleGeometryModelComponent>();
-			GameCore::ComponentContainer<GameCore::Entity3DTransformComponent>* transformContainer = GameCore::EntityModule::GetInstance()->GetComponentContainer<GameCore::Entity3DTransformComponent>();
-			for (auto iter = container->begin(), end = container->end(); iter != end; ++iter)
-			{
-				if (GameCore::Entity3DTransformComponent* transform = transformContainer->GetComponent(iter.GetEntityId()))
-					iter.GetComponent()->Update(transform->GetMatrix());
-			}
-		}
-
-		{
-			GameCore::ComponentContainer<EntityglTFModelComponent>* container = GameCore::EntityModule::GetInstance()->GetComponentContainer<EntityglTFModelComponent>();
-			GameCore::ComponentContainer<GameCore::Entity3DTransformComponent>* transformContainer = GameCore::EntityModule::GetInstance()->GetComponentContainer<GameCore::Entity3DTransformComponent>();
-			for (auto iter = container->begin(), end = container->end(); iter != end; ++iter)
-			{
-				if (GameCore::Entity3DTransformComponent* transform = transformContainer->GetComponent(iter.GetEntityId()))
-					iter.GetComponent()->Update(transform->GetMatrix());
-			}
-		}
+		UpdateModels<EntitySimpleGeometryModelComponent>(myModelsUpdateTick);
+		UpdateModels<EntityglTFModelComponent>(myModelsUpdateTick);
+		myModelsUpdateTick = GameCore::EntityModule::GetInstance()->GetChangeTick();
 
 		{
 			GameCore::ComponentContainer<EntityGuiComponent>* container = GameCore::EntityModule::GetInstance()->GetComponentContainer<EntityGuiComponent>();
@@ -71,6 +71,9 @@ namespace Render
 		void UpdateMaxInFlightFramesCount();
 		uint myMaxInFlightFramesCount = 0;
 
+		// Models are updated for the changes made during this tick or later
+		uint myModelsUpdateTick = 0;
+
 		void RecycleDescriptorSets();
 		std::array<DescriptorContainer, (size_t)ShaderHelpers::BindType::Count> myDescriptorContainers;
 	};
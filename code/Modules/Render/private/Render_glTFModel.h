@@ -153,6 +153,7 @@ namespace Render
 		~glTFModel();
 
 		void Update(const glm::mat4& aMatrix) override;
+		bool IsAnimated() const override { return myAnimations.size() > 0; }
 		void Draw(VkCommandBuffer aCommandBuffer, VkPipelineLayout aPipelineLayout, uint aDescriptorSetIndex, ShaderHelpers::BindType aType) override;
 
 		glTFNode* GetNodeByIndex(uint anIndex);
@@ -10,11 +10,14 @@ namespace Render
 
 	struct EntityModelComponent
 	{
+		EntityModelComponent() = default;
+		EntityModelComponent(EntityModelComponent&& anOther);
 		virtual ~EntityModelComponent();
 
 		virtual void Load() = 0;
 		void Unload();
-		void Update(const glm::mat4& aMatrix);
+		// Updates the model data used for rendering, the component itself is not modified
+		void Update(const glm::mat4& aMatrix) const;
 
 		Model* GetModel() const { return myModel; }
 
@@ -68,6 +71,7 @@ namespace Render
 	struct EntityGuiComponent
 	{
 		EntityGuiComponent();
+		EntityGuiComponent(EntityGuiComponent&& anOther);
 		~EntityGuiComponent();
 
 		void Load();